@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "AddrIndex.h"
+#include "Epoch.h"
+
+static void
+add_range(addr_index * idx, addr_t start, size_t size, ObjectCode * oc,
+          Section * section) {
+    if(size == 0)
+        return;
+    if(idx->n_pending == idx->pending_capacity) {
+        idx->pending_capacity = idx->pending_capacity == 0
+                                ? 64 : 2 * idx->pending_capacity;
+        idx->pending = realloc(idx->pending,
+                               idx->pending_capacity * sizeof(addr_range));
+        assert(idx->pending != NULL);
+    }
+    idx->pending[idx->n_pending++] = (addr_range){
+            .start = start, .end = start + size, .oc = oc, .section = section };
+}
+
+void
+addr_index_add_object(addr_index * idx, ObjectCode * oc) {
+    for(unsigned i = 0; i < oc->n_sections; i++)
+        add_range(idx, oc->sections[i].start, oc->sections[i].size, oc,
+                  &oc->sections[i]);
+    add_range(idx, oc->info->got_start, oc->info->got_size, oc, NULL);
+}
+
+static int
+compare_ranges(const void * a, const void * b) {
+    addr_t x = ((const addr_range *)a)->start;
+    addr_t y = ((const addr_range *)b)->start;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static addr_ranges *
+alloc_ranges(size_t n) {
+    addr_ranges * r = malloc(sizeof(addr_ranges) + n * sizeof(addr_range));
+    assert(r != NULL);
+    r->n = n;
+    return r;
+}
+
+static void
+publish(addr_index * idx, addr_ranges * ranges) {
+    addr_t reach = 0;
+    for(size_t i = 0; ranges != NULL && i < ranges->n; i++) {
+        if(ranges->ranges[i].end > reach) reach = ranges->ranges[i].end;
+        ranges->ranges[i].reach = reach;
+    }
+    addr_ranges * old = idx->committed;
+    __atomic_store_n(&idx->committed, ranges, __ATOMIC_RELEASE);
+    epoch_retire(old, free);
+}
+
+bool
+addr_index_commit(addr_index * idx) {
+    if(idx->n_pending == 0)
+        return EXIT_SUCCESS;
+    qsort(idx->pending, idx->n_pending, sizeof(addr_range), compare_ranges);
+
+    /* merge the (sorted) pending ranges into a copy of the committed ones */
+    addr_ranges * old = idx->committed;
+    size_t n_old = old == NULL ? 0 : old->n;
+    addr_ranges * r = alloc_ranges(n_old + idx->n_pending);
+    size_t i = 0, j = 0, k = 0;
+    while(i < n_old && j < idx->n_pending)
+        r->ranges[k++] = old->ranges[i].start <= idx->pending[j].start
+                         ? old->ranges[i++] : idx->pending[j++];
+    while(i < n_old)
+        r->ranges[k++] = old->ranges[i++];
+    while(j < idx->n_pending)
+        r->ranges[k++] = idx->pending[j++];
+
+    idx->n_pending = 0;
+    publish(idx, r);
+    return EXIT_SUCCESS;
+}
+
+bool
+addr_index_remove_object(addr_index * idx, ObjectCode * oc) {
+    size_t k = 0;
+    for(size_t i = 0; i < idx->n_pending; i++)
+        if(idx->pending[i].oc != oc)
+            idx->pending[k++] = idx->pending[i];
+    idx->n_pending = k;
+
+    addr_ranges * old = idx->committed;
+    if(old == NULL)
+        return EXIT_SUCCESS;
+    addr_ranges * r = alloc_ranges(old->n);
+    k = 0;
+    for(size_t i = 0; i < old->n; i++)
+        if(old->ranges[i].oc != oc)
+            r->ranges[k++] = old->ranges[i];
+    r->n = k;
+    publish(idx, r);
+    return EXIT_SUCCESS;
+}
+
+bool
+addr_index_lookup(addr_index * idx, addr_t addr, addr_range * range) {
+    bool found = false;
+    epoch_enter();
+    addr_ranges * r = __atomic_load_n(&idx->committed, __ATOMIC_ACQUIRE);
+    if(r != NULL) {
+        /* the last range starting at or before addr */
+        size_t lo = 0, hi = r->n;
+        while(lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if(r->ranges[mid].start <= addr) lo = mid + 1;
+            else hi = mid;
+        }
+        /* only an overlapping range can reach past its successors */
+        for(size_t i = lo; i > 0 && addr < r->ranges[i - 1].reach; i--) {
+            if(addr < r->ranges[i - 1].end) {
+                *range = r->ranges[i - 1];
+                found = true;
+                break;
+            }
+        }
+    }
+    epoch_exit();
+    return found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void
+addr_index_free(addr_index * idx) {
+    publish(idx, NULL);
+    free(idx->pending);
+    idx->pending = NULL;
+    idx->n_pending = 0;
+    idx->pending_capacity = 0;
+}
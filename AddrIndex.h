@@ -0,0 +1,64 @@
+#ifndef LINK_ADDR_INDEX_H
+#define LINK_ADDR_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "Types.h"
+
+/*
+ * Address range index over all loaded sections and GOTs.
+ *
+ * Maps an address to the object (and section) it belongs to, by binary
+ * search over the ranges sorted by start address.  Ranges should not overlap;
+ * if they do (sections that are not loaded, but point into the image, may),
+ * lookups stay correct, but scan the overlap.  Objects are added to a
+ * pending list first, and become visible to lookups once committed; loading
+ * functions commit once they are done publishing their objects, so a batch
+ * of objects costs one merge.
+ *
+ * Like the symbol tables, the committed ranges are replaced as a whole, and
+ * retired through epoch_retire (see Epoch.h).  Lookups don't lock, wait or
+ * allocate; all other functions are writers, and must be serialized (by the
+ * linker lock).
+ */
+typedef struct _addr_range {
+    addr_t       start;
+    addr_t       end;      /* exclusive */
+    ObjectCode * oc;
+    Section    * section;  /* NULL for the object's GOT */
+    addr_t       reach;    /* the largest end of this and all prior ranges */
+} addr_range;
+
+typedef struct _addr_ranges {
+    size_t     n;
+    addr_range ranges[];
+} addr_ranges;
+
+typedef struct _addr_index {
+    addr_ranges * committed;  /* sorted by start; NULL if empty */
+
+    addr_range  * pending;    /* added, but not committed yet */
+    size_t        n_pending;
+    size_t        pending_capacity;
+} addr_index;
+
+/* queue the object's (non empty) sections and GOT for the next commit */
+void
+addr_index_add_object(addr_index * idx, ObjectCode * oc);
+
+/* make the pending ranges visible to lookups */
+bool
+addr_index_commit(addr_index * idx);
+
+/* drop all ranges of the object, e.g. when unloading it */
+bool
+addr_index_remove_object(addr_index * idx, ObjectCode * oc);
+
+/* the range containing addr; EXIT_FAILURE if there is none */
+bool
+addr_index_lookup(addr_index * idx, addr_t addr, addr_range * range);
+
+void
+addr_index_free(addr_index * idx);
+
+#endif //LINK_ADDR_INDEX_H
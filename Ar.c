@@ -43,7 +43,11 @@ read_archive(FILE *ar) {
         n = fread( &h, sizeof(ar_header), 1, ar );
         if (n != 1) {
             if (feof(ar)) { continue; }
-            else { __link_log("Failed to read filename!\n"); abort(); }
+            else {
+                link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                         "Failed to read filename!\n");
+                abort();
+            }
         }
         for(int i = 0; i < 10; i++) {
             if(h.size[i] == ' ') {
@@ -62,7 +66,8 @@ read_archive(FILE *ar) {
         member_size = strtol(h.size, NULL, 10);
 
         if(h.magic[0] != 0x60 || h.magic[1] != 0x0A) {
-            __link_log("Magic not found!\n"); abort(); }
+            link_log(LINK_LOG_ERROR, LINK_LOG_LOAD, "Magic not found!\n");
+            abort(); }
 
         // BSD has #1 prefix for large file names
         // E.g. instead of <name.o>/ we have #1/<fileNameSize>
@@ -83,7 +88,8 @@ read_archive(FILE *ar) {
             assert(symTab != NULL);
             n = fread(symTab, 1, member_size, ar);
             if (member_size != n) {
-                __link_log("Failed to read symbol table\n");
+                link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                         "Failed to read symbol table\n");
                 abort();
             }
             continue;
@@ -94,7 +100,8 @@ read_archive(FILE *ar) {
             assert(nameTab != NULL);
             n = fread(nameTab, 1, member_size, ar);
             if(member_size != n) {
-                __link_log("Faield to read extended names table\n");
+                link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                         "Faield to read extended names table\n");
                 abort();
             }
             /* fix \n separators */
@@ -112,7 +119,11 @@ read_archive(FILE *ar) {
             /* bsd style extended file name */
             fileNameSize = strtol(h.name+3, NULL, 10);
             n = fread(fileName, 1, fileNameSize, ar);
-            if (n != fileNameSize) { __link_log("Filename could not be read!\n"); abort(); }
+            if (n != fileNameSize) {
+                link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                         "Filename could not be read!\n");
+                abort();
+            }
             member_size -= fileNameSize;
         } else {
             strncpy(fileName, h.name, sizeof(h.name));
@@ -132,11 +143,13 @@ read_archive(FILE *ar) {
             assert(o != NULL);
             o->image = calloc(member_size, sizeof(char));
             assert(o->image != NULL);
+            o->offset = ftell(ar);
             o->size  = fread(o->image, 1, member_size, ar);
             o->name  = strdup(fileName);
 
             if(o->size != member_size) {
-                __link_log("Failed to read image\n");
+                link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                         "Failed to read image\n");
                 /* TODO: Free o */
                 abort();
             }
@@ -147,10 +160,29 @@ read_archive(FILE *ar) {
             tmp->next = o;
 
         } else {
-            __link_log("Skipping non object file: %s\n", fileName);
+            link_log(LINK_LOG_DEBUG, LINK_LOG_LOAD,
+                     "Skipping non object file: %s\n", fileName);
             fseek(ar, member_size, SEEK_CUR);
         }
     }
     if(symTab != NULL) free(symTab);
     return objects->next;
 }
+
+uint8_t *
+read_archive_member(FILE *ar, long offset, unsigned size) {
+    if(fseek(ar, offset, SEEK_SET)) {
+        link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                 "Failed to seek to archive member at %ld\n", offset);
+        return NULL;
+    }
+    uint8_t * image = calloc(size, sizeof(char));
+    assert(image != NULL);
+    if(fread(image, 1, size, ar) != size) {
+        link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                 "Failed to read archive member at %ld\n", offset);
+        free(image);
+        return NULL;
+    }
+    return image;
+}
@@ -4,8 +4,12 @@ typedef struct _object {
     char * name;
     uint8_t * image;
     unsigned size;
+    long offset;   /* of the member's contents in the archive file */
     struct _object * next;
 } Object;
 
 Object * read_archive(FILE *ar);
+
+/* read a single member's contents, given its offset and size */
+uint8_t * read_archive_member(FILE *ar, long offset, unsigned size);
 #endif //LINK_AR_H
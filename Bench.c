@@ -0,0 +1,1015 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "Bench.h"
+#include "Linker.h"
+#include "Elf.h"
+#include "BinaryTree.h"
+#include "SymbolTable.h"
+#include "elf/reloc/util.h"
+#include "debug.h"
+
+static uint64_t
+now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * A corpus of symbol names.  If the global linker has symbols loaded, we use
+ * those; otherwise we synthesize z-encoded looking names.
+ */
+typedef struct _corpus {
+    char ** names;
+    hash_t * hashes;
+    size_t n;
+    char * storage;
+} corpus;
+
+static void
+collect_name(symbol_table_entry * e, void * ctx) {
+    corpus * c = ctx;
+    c->names[c->n++] = (char *)e->name;
+}
+
+static void
+make_corpus(corpus * c, size_t n) {
+    memset(c, 0, sizeof(corpus));
+    if(LINKER.gsyms.count > 0) {
+        c->names = calloc(LINKER.gsyms.count, sizeof(char *));
+        assert(c->names != NULL);
+        symbol_table_walk(&LINKER.gsyms, collect_name, c);
+    } else {
+        static const char * modules[] = {
+                "base_GHCziBase", "base_GHCziShow", "base_DataziOldList",
+                "base_GHCziIOziHandleziInternals", "ghczmprim_GHCziClasses",
+                "base_ControlziMonadziSTziLazzyziImp", "base_GHCziReal"
+        };
+        static const char * suffixes[] = {
+                "closure", "info", "con_info", "entry", "srt"
+        };
+        c->names   = calloc(n, sizeof(char *));
+        c->storage = calloc(n, 96);
+        assert(c->names != NULL && c->storage != NULL);
+        for(size_t i = 0; i < n; i++) {
+            c->names[i] = c->storage + i * 96;
+            snprintf(c->names[i], 96, "%s_zdwzdc%lux_%s",
+                     modules[i % (sizeof(modules)/sizeof(char*))],
+                     (unsigned long)i,
+                     suffixes[i % (sizeof(suffixes)/sizeof(char*))]);
+        }
+        c->n = n;
+    }
+    c->hashes = calloc(c->n, sizeof(hash_t));
+    assert(c->hashes != NULL);
+    for(size_t i = 0; i < c->n; i++)
+        c->hashes[i] = hash(c->names[i]);
+}
+
+static void
+free_corpus(corpus * c) {
+    free(c->names);
+    free(c->hashes);
+    free(c->storage);
+}
+
+/* lookups should not simply follow the insertion order */
+static size_t *
+shuffled_indices(size_t n) {
+    size_t * idx = calloc(n, sizeof(size_t));
+    assert(idx != NULL);
+    for(size_t i = 0; i < n; i++) idx[i] = i;
+    srand(42);
+    for(size_t i = n; i > 1; i--) {
+        size_t j = (size_t)rand() % i;
+        size_t t = idx[i-1]; idx[i-1] = idx[j]; idx[j] = t;
+    }
+    return idx;
+}
+
+static void
+free_tree(binary_tree_node * n) {
+    if(n == NULL) return;
+    free_tree(n->left);
+    free_tree(n->right);
+    free(n);
+}
+
+bool
+benchSymbolTable(finder f __attribute__((unused))) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: symbol table\n");
+
+    corpus c;
+    make_corpus(&c, 200000);
+    size_t * order = shuffled_indices(c.n);
+
+    /* binary tree */
+    binary_tree_node * tree = NULL;
+    uint64_t t0 = now_ns();
+    for(size_t i = 0; i < c.n; i++)
+        binary_tree_insert(&tree, c.hashes[i], c.names[i]);
+    uint64_t t1 = now_ns();
+    size_t found = 0;
+    for(size_t i = 0; i < c.n; i++) {
+        void * v = NULL;
+        if(!binary_tree_lookup(tree, c.hashes[order[i]], &v)) found++;
+    }
+    uint64_t t2 = now_ns();
+    __link_log("binary tree:  %lu symbols; insert %6.1f ns/op; lookup %6.1f ns/op (%lu found)\n",
+               (unsigned long)c.n,
+               (double)(t1 - t0) / c.n, (double)(t2 - t1) / c.n,
+               (unsigned long)found);
+    free_tree(tree);
+
+    /* open addressing */
+    symbol_table table = { 0 };
+    t0 = now_ns();
+    for(size_t i = 0; i < c.n; i++)
+        symbol_table_insert(&table, c.hashes[i], c.names[i], c.names[i]);
+    t1 = now_ns();
+    found = 0;
+    for(size_t i = 0; i < c.n; i++) {
+        void * v = NULL;
+        if(!symbol_table_lookup(&table, c.hashes[order[i]], c.names[order[i]], &v))
+            found++;
+    }
+    t2 = now_ns();
+    __link_log("symbol table: %lu symbols; insert %6.1f ns/op; lookup %6.1f ns/op (%lu found)\n",
+               (unsigned long)c.n,
+               (double)(t1 - t0) / c.n, (double)(t2 - t1) / c.n,
+               (unsigned long)found);
+    t0 = now_ns();
+    for(size_t i = 0; i < c.n; i += 2)
+        symbol_table_delete(&table, c.hashes[i], c.names[i], NULL);
+    t1 = now_ns();
+    __link_log("symbol table: delete %6.1f ns/op\n",
+               (double)(t1 - t0) / (c.n / 2));
+    symbol_table_free(&table);
+
+    free(order);
+    free_corpus(&c);
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+benchHash(finder f __attribute__((unused))) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: symbol name hashing\n");
+
+    corpus c;
+    make_corpus(&c, 200000);
+
+    size_t bytes = 0;
+    for(size_t i = 0; i < c.n; i++) bytes += strlen(c.names[i]);
+    __link_log("%lu names, %.1f bytes/name on average\n",
+               (unsigned long)c.n, (double)bytes / c.n);
+
+    /* sum the hashes, so the compiler can't drop the loops */
+    hash_t sum = 0;
+    const unsigned rounds = 10;
+
+    uint64_t t0 = now_ns();
+    for(unsigned r = 0; r < rounds; r++)
+        for(size_t i = 0; i < c.n; i++)
+            sum += knuth_hash(c.names[i], strlen(c.names[i]));
+    uint64_t t1 = now_ns();
+    __link_log("knuth:     %6.1f ns/name\n", (double)(t1 - t0) / (rounds * c.n));
+
+    t0 = now_ns();
+    for(unsigned r = 0; r < rounds; r++)
+        for(size_t i = 0; i < c.n; i++)
+            sum += jenkins_one_at_a_time_hash(c.names[i], strlen(c.names[i]));
+    t1 = now_ns();
+    __link_log("jenkins:   %6.1f ns/name\n", (double)(t1 - t0) / (rounds * c.n));
+
+    t0 = now_ns();
+    for(unsigned r = 0; r < rounds; r++)
+        for(size_t i = 0; i < c.n; i++)
+            sum += wordwise_hash(c.names[i]);
+    t1 = now_ns();
+    __link_log("wordwise:  %6.1f ns/name\n", (double)(t1 - t0) / (rounds * c.n));
+
+    __link_log("(checksum %llx)\n", (unsigned long long)sum);
+    free_corpus(&c);
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+benchLookup(finder f __attribute__((unused))) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: symbol lookup\n");
+
+    corpus c;
+    make_corpus(&c, 200000);
+    size_t * order = shuffled_indices(c.n);
+
+    /* a private linker session with one global symbol per name */
+    Linker l = { 0 };
+    ElfSymbol * symbols = calloc(c.n, sizeof(ElfSymbol));
+    GlobalSymbol * globals = calloc(c.n, sizeof(GlobalSymbol));
+    assert(symbols != NULL && globals != NULL);
+    for(size_t i = 0; i < c.n; i++) {
+        symbols[i] = (ElfSymbol){ .name = c.names[i], .hash = c.hashes[i],
+                                  .hash_valid = true, .addr = (addr_t)(i + 1) };
+        globals[i] = (GlobalSymbol){ .symbol = &symbols[i] };
+        insert_global_symbol(&l, &globals[i]);
+    }
+
+    char ** names = calloc(c.n, sizeof(char *));
+    addr_t * out = calloc(c.n, sizeof(addr_t));
+    SymbolHandle * handles = calloc(c.n, sizeof(SymbolHandle));
+    assert(names != NULL && out != NULL && handles != NULL);
+    for(size_t i = 0; i < c.n; i++) names[i] = c.names[order[i]];
+
+    uint64_t t0 = now_ns();
+    for(size_t i = 0; i < c.n; i++)
+        out[i] = lookupSymbol_(&l, names[i]);
+    uint64_t t1 = now_ns();
+    __link_log("single lookups:  %6.1f ns/symbol\n", (double)(t1 - t0) / c.n);
+
+    for(size_t batch = 16; batch <= c.n; batch *= 16) {
+        t0 = now_ns();
+        for(size_t i = 0; i < c.n; i += batch)
+            lookupSymbols_(&l, names + i, i + batch > c.n ? c.n - i : batch,
+                           out + i);
+        t1 = now_ns();
+        __link_log("batch of %6lu: %6.1f ns/symbol\n", (unsigned long)batch,
+                   (double)(t1 - t0) / c.n);
+    }
+
+    for(size_t i = 0; i < c.n; i++)
+        lookupSymbolHandle_(&l, names[i], &handles[i]);
+    t0 = now_ns();
+    for(size_t i = 0; i < c.n; i++)
+        out[i] = symbolHandleAddr(&l, &handles[i]);
+    t1 = now_ns();
+    __link_log("handles:         %6.1f ns/symbol\n", (double)(t1 - t0) / c.n);
+
+    for(size_t i = 0; i < c.n; i++)
+        if(out[i] != (addr_t)(order[i] + 1)) abort();
+
+    symbol_table_free(&l.gsyms);
+    free(handles); free(out); free(names);
+    free(globals); free(symbols);
+    free(order);
+    free_corpus(&c);
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Time to a resolved hs_init, when loading all archives (cold), and when
+ * loading from the symbol index written by the cold session (warm).  Expects
+ * the shared libraries the archives depend on to be loaded already; see
+ * testLoadHS.
+ */
+bool
+benchWarmStart(finder findFile) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: warm start\n");
+
+    char * archives[] = {
+            "libgcc",
+            "libCffi_thr",
+            "libHSrts_thr_debug",
+            "libHSghc-prim-0.5.0.0",
+            "libHSinteger-simple-0.1.1.1",
+            "libHSbase-4.10.0.0",
+    };
+    char lib[128];  memset(lib, 0, sizeof lib);
+    char path[160]; memset(path, 0, sizeof path);
+
+    uint64_t t0 = now_ns();
+    Linker cold = { .objects = NULL };
+    linkerIndexLibrary(&cold, "libc.so");
+    for(unsigned i = 0; i < sizeof(archives)/sizeof(char*); i++) {
+        if(findFile(lib, sizeof(lib), archives[i], "a")) abort();
+        loadArchive(&cold, lib);
+    }
+    if(resolvePending(&cold)) abort();
+    if(0x0 == lookupSymbol_(&cold, "hs_init")) abort();
+    uint64_t t1 = now_ns();
+
+    snprintf(path, sizeof(path), "%s.idx", lib);
+    if(writeSymbolIndex(&cold, path)) abort();
+
+    for(int validate = 0; validate <= 1; validate++) {
+        uint64_t t2 = now_ns();
+        Linker warm = { .objects = NULL };
+        linkerIndexLibrary(&warm, "libc.so");
+        SymbolIndex * idx = loadSymbolIndex(path, validate);
+        if(idx == NULL) abort();
+        attachSymbolIndex(&warm, idx);
+        if(0x0 == lookupSymbol_(&warm, "hs_init")) abort();
+        uint64_t t3 = now_ns();
+        __link_log("warm (%s): %8.2f ms; %u of %u objects loaded\n",
+                   validate ? "content validated" : "size/mtime validated",
+                   (double)(t3 - t2) / 1e6,
+                   count_objects(&warm), count_objects(&cold));
+    }
+    __link_log("cold:                          %8.2f ms\n",
+               (double)(t1 - t0) / 1e6);
+    unlink(path);
+
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+typedef struct _lookup_worker {
+    Linker * l;
+    corpus * c;
+    size_t * order;
+    size_t   start;
+    size_t   lookups;
+    bool   * stop;
+    uint64_t ns;
+} lookup_worker;
+
+static void *
+lookup_worker_run(void * arg) {
+    lookup_worker * w = arg;
+    size_t found = 0;
+    uint64_t t0 = now_ns();
+    for(size_t i = 0; i < w->lookups; i++) {
+        size_t k = w->order[(w->start + i) % w->c->n];
+        GlobalSymbol * g = NULL;
+        if(!symbol_table_lookup(&w->l->gsyms, w->c->hashes[k], w->c->names[k],
+                                (void**)&g))
+            found++;
+    }
+    w->ns = now_ns() - t0;
+    if(found != w->lookups) abort(/* all of them are published */);
+    return NULL;
+}
+
+/* keep inserting fresh symbols (and growing the table) until stopped */
+typedef struct _insert_worker {
+    Linker * l;
+    bool   * stop;
+    size_t   next;      /* suffix of the next name; unique across runs */
+    size_t   inserted;
+} insert_worker;
+
+static void *
+insert_worker_run(void * arg) {
+    insert_worker * w = arg;
+    while(!__atomic_load_n(w->stop, __ATOMIC_ACQUIRE)) {
+        char name[32];
+        snprintf(name, sizeof(name), "__bench_insert_%lu",
+                 (unsigned long)w->next++);
+        ElfSymbol * s = calloc(1, sizeof(ElfSymbol));
+        GlobalSymbol * g = calloc(1, sizeof(GlobalSymbol));
+        assert(s != NULL && g != NULL);
+        *s = (ElfSymbol){ .name = name, .hash = hash(name), .hash_valid = true,
+                          .addr = (addr_t)1 };
+        g->symbol = s;
+        insert_global_symbol(w->l, g);
+        w->inserted++;
+    }
+    return NULL;
+}
+
+/*
+ * Lookup throughput over the number of reader threads, with and without a
+ * thread inserting into the same table concurrently.
+ */
+bool
+benchConcurrentLookup(finder f __attribute__((unused))) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: concurrent symbol lookup\n");
+
+    enum { MAX_THREADS = 32, LOOKUPS = 2000000 };
+    corpus c;
+    make_corpus(&c, 200000);
+    size_t * order = shuffled_indices(c.n);
+
+    Linker l = { 0 };
+    ElfSymbol * symbols = calloc(c.n, sizeof(ElfSymbol));
+    GlobalSymbol * globals = calloc(c.n, sizeof(GlobalSymbol));
+    assert(symbols != NULL && globals != NULL);
+    for(size_t i = 0; i < c.n; i++) {
+        symbols[i] = (ElfSymbol){ .name = c.names[i], .hash = c.hashes[i],
+                                  .hash_valid = true, .addr = (addr_t)(i + 1) };
+        globals[i] = (GlobalSymbol){ .symbol = &symbols[i] };
+        insert_global_symbol(&l, &globals[i]);
+    }
+
+    double single = 0;
+    size_t next_insert = 0;
+    for(int writing = 0; writing <= 1; writing++) {
+        for(unsigned n = 1; n <= MAX_THREADS; n *= 2) {
+            bool stop = false;
+            insert_worker writer = { .l = &l, .stop = &stop,
+                                     .next = next_insert };
+            pthread_t writer_thread;
+            if(writing && pthread_create(&writer_thread, NULL,
+                                         insert_worker_run, &writer))
+                abort();
+
+            lookup_worker workers[MAX_THREADS];
+            pthread_t threads[MAX_THREADS];
+            for(unsigned t = 0; t < n; t++) {
+                workers[t] = (lookup_worker){ .l = &l, .c = &c, .order = order,
+                                              .start = t * (c.n / n),
+                                              .lookups = LOOKUPS };
+                if(pthread_create(&threads[t], NULL, lookup_worker_run,
+                                  &workers[t]))
+                    abort();
+            }
+            uint64_t slowest = 0;
+            for(unsigned t = 0; t < n; t++) {
+                pthread_join(threads[t], NULL);
+                if(workers[t].ns > slowest) slowest = workers[t].ns;
+            }
+            __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+            if(writing) pthread_join(writer_thread, NULL);
+            next_insert = writer.next;
+
+            double rate = (double)n * LOOKUPS / ((double)slowest / 1e9) / 1e6;
+            if(n == 1 && !writing) single = rate;
+            __link_log("%2u readers%s: %7.1f Mlookups/s (%4.1fx)\n", n,
+                       writing ? " + writer" : "         ", rate,
+                       rate / single);
+            if(writing)
+                __link_log("            %lu symbols inserted meanwhile\n",
+                           (unsigned long)writer.inserted);
+        }
+    }
+
+    symbol_table_free(&l.gsyms);
+    interned_names_free(&l.names);
+    free(globals); free(symbols);
+    free(order);
+    free_corpus(&c);
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Time to load (not resolve) libHSbase, over the number of threads members
+ * are processed by.  Each run uses a private linker session.
+ */
+bool
+benchParallelArchive(finder findFile) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: parallel archive loading\n");
+
+    char lib[128];  memset(lib, 0, sizeof lib);
+    if(findFile(lib, sizeof(lib), "libHSbase-4.10.0.0", "a")) abort();
+
+    double serial = 0;
+    size_t n_symbols = 0;
+    for(unsigned n = 1; n <= 32; n *= 2) {
+        Linker l = { .objects = NULL };
+        uint64_t t0 = now_ns();
+        loadArchiveParallel(&l, lib, n);
+        uint64_t t1 = now_ns();
+
+        double ms = (double)(t1 - t0) / 1e6;
+        if(n == 1) {
+            serial = ms;
+            n_symbols = l.gsyms.count;
+        }
+        if(l.gsyms.count != n_symbols) abort(/* must match the serial load */);
+        __link_log("%2u threads: %8.2f ms (%4.1fx); %u objects, %lu symbols\n",
+                   n, ms, serial / ms, count_objects(&l),
+                   (unsigned long)l.gsyms.count);
+    }
+
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+/* the old find_near_symbol; a linear scan over the owner's symbols */
+static ElfSymbol *
+find_near_symbol_linear(Linker * l, addr_t addr) {
+    ObjectCode * oc = find_section(l, addr).oc;
+    if(oc == NULL)
+        return NULL;
+    for(ElfSymbolTable * stab=oc->info->symbolTables;
+        stab != NULL; stab = stab->next) {
+        for(unsigned i = 0; i < stab->n_symbols; i++) {
+            ElfSymbol * s = &stab->symbols[i];
+            if(s->elf_sym->st_size == 0) continue;
+            if(s->addr <= addr && (addr < s->addr + s->elf_sym->st_size))
+                return s;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Symbolization throughput, for (pseudo) profile samples spread over all
+ * text sections.  Uses the global linker's objects, if any are loaded;
+ * otherwise loads libHSbase into a private session.
+ */
+bool
+benchSymbolize(finder findFile) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: symbolization\n");
+
+    Linker private = { .objects = NULL };
+    Linker * l = &LINKER;
+    if(l->objects == NULL) {
+        char lib[128];  memset(lib, 0, sizeof lib);
+        if(findFile(lib, sizeof(lib), "libHSbase-4.10.0.0", "a")) abort();
+        loadArchive(&private, lib);
+        l = &private;
+    }
+
+    /* collect all text sections, and sample addresses uniformly across
+     * their bytes */
+    size_t n_text = 0, text_bytes = 0;
+    for(ObjectCode * oc = l->objects; oc != NULL; oc = oc->next)
+        for(unsigned i = 0; i < oc->n_sections; i++)
+            if(oc->sections[i].kind == SECTIONKIND_TEXT
+               && oc->sections[i].size > 0) {
+                n_text++;
+                text_bytes += oc->sections[i].size;
+            }
+    Section ** text = calloc(n_text, sizeof(Section *));
+    assert(n_text == 0 || text != NULL);
+    n_text = 0;
+    for(ObjectCode * oc = l->objects; oc != NULL; oc = oc->next)
+        for(unsigned i = 0; i < oc->n_sections; i++)
+            if(oc->sections[i].kind == SECTIONKIND_TEXT
+               && oc->sections[i].size > 0)
+                text[n_text++] = &oc->sections[i];
+
+    enum { SAMPLES = 200000 };
+    addr_t * samples = calloc(SAMPLES, sizeof(addr_t));
+    assert(samples != NULL);
+    srand(42);
+    for(size_t i = 0; i < SAMPLES && n_text > 0; i++) {
+        Section * s = text[(size_t)rand() % n_text];
+        samples[i] = s->start + (size_t)rand() % s->size;
+    }
+
+    size_t found = 0;
+    uint64_t t0 = now_ns();
+    for(size_t i = 0; i < SAMPLES; i++)
+        if(find_near_symbol(l, samples[i]) != NULL) found++;
+    uint64_t t1 = now_ns();
+    size_t found_linear = 0;
+    for(size_t i = 0; i < SAMPLES; i++)
+        if(find_near_symbol_linear(l, samples[i]) != NULL) found_linear++;
+    uint64_t t2 = now_ns();
+    /* nested symbols: the scan finds the first in symbol table order, the
+     * sorted search the innermost */
+    size_t mismatches = 0;
+    for(size_t i = 0; i < SAMPLES; i++)
+        if(find_near_symbol(l, samples[i])
+           != find_near_symbol_linear(l, samples[i]))
+            mismatches++;
+
+    __link_log("%lu objects, %lu text sections (%lu bytes)\n",
+               (unsigned long)count_objects(l), (unsigned long)n_text,
+               (unsigned long)text_bytes);
+    __link_log("sorted: %10.0f samples/s (%lu symbolized)\n",
+               SAMPLES / ((double)(t1 - t0) / 1e9), (unsigned long)found);
+    __link_log("linear: %10.0f samples/s (%lu symbolized)\n",
+               SAMPLES / ((double)(t2 - t1) / 1e9), (unsigned long)found_linear);
+    __link_log("%lu samples symbolized differently\n",
+               (unsigned long)mismatches);
+
+    free(samples);
+    free(text);
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+uint8_t *
+make_object(const bench_object * o, uint8_t ** text, size_t * image_size) {
+    static const char shstrtab[] =
+            "\0.text\0.data\0.rel\0.symtab\0.strtab\0.shstrtab";
+    size_t rel_size = BENCH_WITH_ADDEND ? sizeof(ElfRela) : sizeof(ElfRel);
+
+    size_t text_off   = 64;
+    size_t data_off   = text_off + ((o->text_size + 15) & ~(size_t)15);
+    size_t rel_off    = data_off + ((o->data_size + 7) & ~(size_t)7);
+    size_t symtab_off = rel_off + o->nrels * rel_size;
+    size_t strtab_off = symtab_off + (o->nsyms + 1) * sizeof(ElfSym);
+    size_t shstr_off  = strtab_off + o->strtab_size;
+    size_t shdr_off   = (shstr_off + sizeof(shstrtab) + 7) & ~(size_t)7;
+    *image_size = shdr_off + BENCH_N_SHDRS * sizeof(ElfShdr);
+
+    uint8_t * image = calloc(1, *image_size);
+    assert(image != NULL);
+
+    ElfEhdr * ehdr = (ElfEhdr *)image;
+    memcpy(ehdr->e_ident, ELFMAG, SELFMAG);
+    ehdr->e_ident[EI_CLASS]   = sizeof(addr_t) == 8 ? ELFCLASS64 : ELFCLASS32;
+    ehdr->e_ident[EI_DATA]    = ELFDATA2LSB;
+    ehdr->e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr->e_type      = ET_REL;
+    ehdr->e_machine   = BENCH_MACHINE;
+    ehdr->e_version   = EV_CURRENT;
+    ehdr->e_shoff     = shdr_off;
+    ehdr->e_ehsize    = sizeof(ElfEhdr);
+    ehdr->e_shentsize = sizeof(ElfShdr);
+    ehdr->e_shnum     = BENCH_N_SHDRS;
+    ehdr->e_shstrndx  = BENCH_SHSTRTAB;
+
+    memcpy(image + rel_off, o->rels, o->nrels * rel_size);
+    memcpy(image + symtab_off + sizeof(ElfSym), o->syms,
+           o->nsyms * sizeof(ElfSym));
+    memcpy(image + strtab_off, o->strtab, o->strtab_size);
+    memcpy(image + shstr_off, shstrtab, sizeof(shstrtab));
+    size_t locals = 1;
+    while(locals <= o->nsyms
+          && ELF_ST_BIND(o->syms[locals - 1].st_info) == STB_LOCAL)
+        locals++;
+
+    ElfShdr * shdr = (ElfShdr *)(image + shdr_off);
+    shdr[BENCH_TEXT]     = (ElfShdr){ .sh_name = 1, .sh_type = SHT_PROGBITS,
+                                      .sh_flags = SHF_ALLOC | SHF_EXECINSTR,
+                                      .sh_offset = text_off,
+                                      .sh_size = o->text_size,
+                                      .sh_addralign = 16 };
+    shdr[BENCH_DATA]     = (ElfShdr){ .sh_name = 7, .sh_type = SHT_PROGBITS,
+                                      .sh_flags = SHF_ALLOC | SHF_WRITE,
+                                      .sh_offset = data_off,
+                                      .sh_size = o->data_size,
+                                      .sh_addralign = sizeof(addr_t) };
+    shdr[BENCH_REL]      = (ElfShdr){ .sh_name = 13,
+                                      .sh_type = BENCH_WITH_ADDEND ? SHT_RELA
+                                                                   : SHT_REL,
+                                      .sh_offset = rel_off,
+                                      .sh_size = o->nrels * rel_size,
+                                      .sh_link = BENCH_SYMTAB,
+                                      .sh_info = o->rel_section,
+                                      .sh_addralign = 8,
+                                      .sh_entsize = rel_size };
+    shdr[BENCH_SYMTAB]   = (ElfShdr){ .sh_name = 18, .sh_type = SHT_SYMTAB,
+                                      .sh_offset = symtab_off,
+                                      .sh_size = (o->nsyms + 1) * sizeof(ElfSym),
+                                      .sh_link = BENCH_STRTAB,
+                                      .sh_info = locals,
+                                      .sh_addralign = 8,
+                                      .sh_entsize = sizeof(ElfSym) };
+    shdr[BENCH_STRTAB]   = (ElfShdr){ .sh_name = 26, .sh_type = SHT_STRTAB,
+                                      .sh_offset = strtab_off,
+                                      .sh_size = o->strtab_size,
+                                      .sh_addralign = 1 };
+    shdr[BENCH_SHSTRTAB] = (ElfShdr){ .sh_name = 34, .sh_type = SHT_STRTAB,
+                                      .sh_offset = shstr_off,
+                                      .sh_size = sizeof(shstrtab),
+                                      .sh_addralign = 1 };
+    *text = image + text_off;
+    return image;
+}
+
+/*
+ * A relocatable object with a single text section of size bytes, holding a
+ * return instruction at the start of every stride bytes.  The global symbol
+ * bench_text marks the start of the section.
+ */
+static uint8_t *
+make_text_object(size_t size, size_t stride, size_t * image_size) {
+    static const char strtab[] = "\0bench_text";
+    ElfSym sym = { .st_name = 1, .st_info = (STB_GLOBAL << 4) | STT_FUNC,
+                   .st_shndx = BENCH_TEXT, .st_size = size };
+    bench_object o = { .text_size = size, .syms = &sym, .nsyms = 1,
+                       .strtab = strtab, .strtab_size = sizeof(strtab),
+                       .rel_section = BENCH_TEXT };
+    uint8_t * text = NULL;
+    uint8_t * image = make_object(&o, &text, image_size);
+    const uint32_t ret = BENCH_RET;
+    for(size_t off = 0; off + sizeof(ret) <= size; off += stride)
+        memcpy(text + off, &ret, sizeof(ret));
+    return image;
+}
+
+/* a hardware cache event counter for this thread; -1 if not permitted */
+static int
+open_cache_counter(unsigned cache, unsigned op, unsigned result) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type           = PERF_TYPE_HW_CACHE;
+    attr.size           = sizeof(attr);
+    attr.config         = cache | (op << 8) | (result << 16);
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * iTLB misses and time per call, for calls spread over 16 MiB of text (one
+ * function per page, called in random order), with the text on regular
+ * pages, transparent huge pages and MAP_HUGETLB pages.  Note that with THP
+ * enabled system wide ("always"), the regular mapping may be backed by huge
+ * pages, too.  Counting needs perf_event access (perf_event_paranoid).
+ */
+bool
+benchHugeText(finder f __attribute__((unused))) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: huge page text\n");
+
+    enum { TEXT_SIZE = 16 << 20, ROUNDS = 20 };
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t n = TEXT_SIZE / page;
+    size_t image_size = 0;
+    uint8_t * image = make_text_object(TEXT_SIZE, page, &image_size);
+    size_t * order = shuffled_indices(n);
+
+    struct { unsigned flags; const char * name; } modes[] = {
+            { 0,                 "regular pages" },
+            { LOAD_HUGE_TEXT,    "THP          " },
+            { LOAD_HUGETLB_TEXT, "MAP_HUGETLB  " },
+    };
+    for(size_t m = 0; m < sizeof(modes)/sizeof(modes[0]); m++) {
+        /* one session per mode, borrowing the image */
+        Linker * l = calloc(1, sizeof(Linker));
+        assert(l != NULL);
+        l->loadFlags = modes[m].flags;
+        ObjectCode * oc = loadObjectFromMemory(l, "bench_text.o", image,
+                                               image_size, IMAGE_BORROW);
+        if(oc == NULL || resolveObject(l, oc)) abort();
+        uint8_t * text = (uint8_t *)lookupSymbol_(l, "bench_text");
+        if(text == NULL) abort();
+        __builtin___clear_cache((char *)text, (char *)text + TEXT_SIZE);
+
+        /* fault everything in first */
+        for(size_t i = 0; i < n; i++)
+            ((void (*)(void))(text + i * page))();
+
+        int fd = open_cache_counter(PERF_COUNT_HW_CACHE_ITLB,
+                                    PERF_COUNT_HW_CACHE_OP_READ,
+                                    PERF_COUNT_HW_CACHE_RESULT_MISS);
+        if(fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        uint64_t t0 = now_ns();
+        for(int r = 0; r < ROUNDS; r++)
+            for(size_t i = 0; i < n; i++)
+                ((void (*)(void))(text + order[i] * page))();
+        uint64_t t1 = now_ns();
+        uint64_t misses = 0;
+        if(fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if(read(fd, &misses, sizeof(misses)) != sizeof(misses))
+                misses = 0;
+            close(fd);
+        }
+
+        double calls = (double)n * ROUNDS;
+        if(fd >= 0)
+            __link_log("%s: %6.2f ns/call, %6.3f iTLB misses/call\n",
+                       modes[m].name, (double)(t1 - t0) / calls,
+                       (double)misses / calls);
+        else
+            __link_log("%s: %6.2f ns/call, iTLB misses not available\n",
+                       modes[m].name, (double)(t1 - t0) / calls);
+        log_linker_stats(l);
+        linkerFree(l);
+        free(l);
+    }
+
+    free(image);
+    free(order);
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+/*
+ * A relocatable object with n relocations of the given type, against nsyms
+ * local functions in its text section, in random order.  With insn 0, the
+ * relocations are to consecutive places of width bytes in a data section;
+ * otherwise, to consecutive instructions insn in the text section.
+ */
+static uint8_t *
+make_reloc_object(size_t n, unsigned type, uint32_t insn, size_t width,
+                  size_t nsyms, size_t * image_size) {
+    static const char strtab[] = "";
+    size_t rel_size = BENCH_WITH_ADDEND ? sizeof(ElfRela) : sizeof(ElfRel);
+    size_t words = insn != 0 && n > nsyms ? n : nsyms;
+
+    ElfSym * syms = calloc(nsyms, sizeof(ElfSym));
+    uint8_t * rels = calloc(n + 1, rel_size);
+    assert(syms != NULL && rels != NULL);
+    for(size_t k = 0; k < nsyms; k++) {
+        syms[k].st_info  = (STB_LOCAL << 4) | STT_FUNC;
+        syms[k].st_shndx = BENCH_TEXT;
+        syms[k].st_value = 4 * k;
+        syms[k].st_size  = 4;
+    }
+    size_t * order = shuffled_indices(n);
+    for(size_t i = 0; i < n; i++) {
+        addr_t offset = insn != 0 ? 4 * i : width * i;
+        size_t sym = 1 + order[i] % nsyms;
+#if BENCH_WITH_ADDEND
+        ((ElfRela *)rels)[i] = (ElfRela){
+                .r_offset = offset, .r_info = ELF_R_INFO(sym, type) };
+#else
+        ((ElfRel *)rels)[i] = (ElfRel){
+                .r_offset = offset, .r_info = ELF_R_INFO(sym, type) };
+#endif
+    }
+    free(order);
+
+    bench_object o = {
+            .text_size = words * 4,
+            .data_size = insn != 0 ? sizeof(addr_t) : n * width,
+            .syms = syms, .nsyms = nsyms,
+            .strtab = strtab, .strtab_size = sizeof(strtab),
+            .rels = rels, .nrels = n,
+            .rel_section = insn != 0 ? BENCH_TEXT : BENCH_DATA };
+    uint8_t * text = NULL;
+    uint8_t * image = make_object(&o, &text, image_size);
+    free(rels);
+    free(syms);
+
+    for(size_t i = 0; i < words; i++) {
+        uint32_t word = insn != 0 && i < n ? insn : BENCH_RET;
+        memcpy(text + 4 * i, &word, sizeof(word));
+    }
+    return image;
+}
+
+/* the symbols of the relocations, looked up either way; sums the pointers */
+static addr_t
+sum_symbols(ObjectCode * oc, bool bound) {
+    addr_t sum = 0;
+#if BENCH_WITH_ADDEND
+    for(ElfRelocationATable * t = oc->info->relaTable; t != NULL; t = t->next)
+#else
+    for(ElfRelocationTable * t = oc->info->relTable; t != NULL; t = t->next)
+#endif
+        for(size_t i = 0; i < t->n_relocations; i++) {
+            unsigned long sym = ELF_R_SYM(t->relocations[i].r_info);
+            sum += (addr_t)(bound
+                    ? table_symbol(t->symbolTable, sym)
+                    : find_symbol(oc, t->sectionHeader->sh_link, sym));
+        }
+    return sum;
+}
+
+/*
+ * The relocation phase (resolveObject) for an object with 1M data
+ * relocations to 4096 symbols; and the symbol lookup per relocation, through
+ * the relocation table's bound symbol table and through the list of symbol
+ * tables (find_symbol), which the relocators used before.
+ */
+bool
+benchRelocate(finder f __attribute__((unused))) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: relocation\n");
+
+    enum { N = 1 << 20, NSYMS = 4096, ROUNDS = 10 };
+#if defined(__aarch64__)
+    unsigned type = AARCH64_ABS64;
+#else
+    unsigned type = ARM_ABS32;
+#endif
+    size_t image_size = 0;
+    uint8_t * image = make_reloc_object(N, type, 0, sizeof(addr_t), NSYMS,
+                                          &image_size);
+
+    Linker * l = calloc(1, sizeof(Linker));
+    assert(l != NULL);
+    ObjectCode * oc = loadObjectFromMemory(l, "bench_reloc.o", image,
+                                           image_size, IMAGE_ADOPT);
+    if(oc == NULL) abort();
+    uint64_t t0 = now_ns();
+    if(resolveObject(l, oc)) abort();
+    uint64_t t1 = now_ns();
+    __link_log("resolve:           %6.2f ns/relocation (%d relocations)\n",
+               (double)(t1 - t0) / N, N);
+
+    addr_t sum = 0;
+    t0 = now_ns();
+    for(int r = 0; r < ROUNDS; r++)
+        sum += sum_symbols(oc, false);
+    t1 = now_ns();
+    for(int r = 0; r < ROUNDS; r++)
+        sum -= sum_symbols(oc, true);
+    uint64_t t2 = now_ns();
+    if(sum != 0) abort(/* the two disagree */);
+    __link_log("symbol lookup:     %6.2f ns/relocation via find_symbol, "
+               "%6.2f ns/relocation bound\n",
+               (double)(t1 - t0) / ((double)N * ROUNDS),
+               (double)(t2 - t1) / ((double)N * ROUNDS));
+
+    /* the image goes with the session, which adopted it */
+    linkerFree(l);
+    free(l);
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Relocation throughput by type: 1M relocations of a single type to 4096
+ * symbols, through resolveObject.  The data relocations are to consecutive
+ * places, as in info tables.
+ */
+bool
+benchRelocateTypes(finder f __attribute__((unused))) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: relocation throughput by type\n");
+
+    enum { N = 1 << 20, NSYMS = 4096 };
+    struct {
+        unsigned type; uint32_t insn; size_t width; const char * name;
+    } types[] = {
+#if defined(__aarch64__)
+            { AARCH64_ABS64,            0,          8, "ABS64           " },
+            { AARCH64_PREL32,           0,          4, "PREL32          " },
+            { AARCH64_PREL64,           0,          8, "PREL64          " },
+            { AARCH64_CALL26,           0x94000000, 4, "CALL26          " },
+            { AARCH64_ADR_PREL_PG_HI21, 0x90000000, 4, "ADR_PREL_PG_HI21" },
+            { AARCH64_ADD_ABS_LO12_NC,  0x91000000, 4, "ADD_ABS_LO12_NC " },
+#else
+            { ARM_ABS32,                0,          4, "ABS32           " },
+            { ARM_REL32,                0,          4, "REL32           " },
+            { ARM_CALL,                 0xebfffffe, 4, "CALL            " },
+#endif
+    };
+    for(size_t t = 0; t < sizeof(types)/sizeof(types[0]); t++) {
+        size_t image_size = 0;
+        uint8_t * image = make_reloc_object(N, types[t].type, types[t].insn,
+                                            types[t].width, NSYMS,
+                                            &image_size);
+        /* one session per type, adopting the image */
+        Linker * l = calloc(1, sizeof(Linker));
+        assert(l != NULL);
+        ObjectCode * oc = loadObjectFromMemory(l, "bench_reloc.o", image,
+                                               image_size, IMAGE_ADOPT);
+        if(oc == NULL) abort();
+        uint64_t t0 = now_ns();
+        if(resolveObject(l, oc)) abort();
+        uint64_t t1 = now_ns();
+        __link_log("%s: %6.2f ns/relocation, %7.1f M relocations/s\n",
+                   types[t].name, (double)(t1 - t0) / N,
+                   (double)N * 1e3 / (double)(t1 - t0));
+        linkerFree(l);
+        free(l);
+    }
+
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Time to resolve 64 objects (resolveAll), over the number of threads, with
+ * 64K relocations each; a data and a branch type, by turns.  Each run uses a
+ * private linker session.
+ */
+bool
+benchResolveAll(finder f __attribute__((unused))) {
+    __link_log("================================================================================\n");
+    __link_log("Bench: parallel resolve\n");
+
+    enum { OBJECTS = 64, N = 1 << 16, NSYMS = 4096 };
+#if defined(__aarch64__)
+    unsigned data = AARCH64_ABS64, call = AARCH64_CALL26;
+    uint32_t insn = 0x94000000;
+#else
+    unsigned data = ARM_ABS32, call = ARM_CALL;
+    uint32_t insn = 0xebfffffe;
+#endif
+    double serial = 0;
+    for(unsigned n = 1; n <= 32; n *= 2) {
+        /* one session per run, adopting the images */
+        Linker * l = calloc(1, sizeof(Linker));
+        assert(l != NULL);
+        for(int k = 0; k < OBJECTS; k++) {
+            size_t image_size = 0;
+            uint8_t * image = k % 2 == 0
+                    ? make_reloc_object(N, data, 0, sizeof(addr_t), NSYMS,
+                                        &image_size)
+                    : make_reloc_object(N, call, insn, 4, NSYMS, &image_size);
+            if(NULL == loadObjectFromMemory(l, "bench_resolve.o", image,
+                                            image_size, IMAGE_ADOPT))
+                abort();
+        }
+        uint64_t t0 = now_ns();
+        if(resolveAll(l, n)) abort();
+        uint64_t t1 = now_ns();
+
+        double ms = (double)(t1 - t0) / 1e6;
+        if(n == 1)
+            serial = ms;
+        __link_log("%2u threads: %8.2f ms (%4.1fx); %5.1f M relocations/s\n",
+                   n, ms, serial / ms,
+                   (double)OBJECTS * N * 1e3 / (double)(t1 - t0));
+        linkerFree(l);
+        free(l);
+    }
+
+    __link_log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#ifndef LINK_BENCH_H
+#define LINK_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "Tests.h"
+#include "Types.h"
+
+/*
+ * Micro benchmarks.  These are driven by the embedder just like the tests,
+ * and report their numbers through the log.
+ */
+bool  benchSymbolTable(finder f);
+bool  benchHash(finder f);
+bool  benchLookup(finder f);
+bool  benchWarmStart(finder f);
+bool  benchConcurrentLookup(finder f);
+bool  benchParallelArchive(finder f);
+bool  benchSymbolize(finder f);
+bool  benchHugeText(finder f);
+bool  benchRelocate(finder f);
+bool  benchRelocateTypes(finder f);
+bool  benchResolveAll(finder f);
+
+#if defined(__aarch64__)
+#define BENCH_WITH_ADDEND       1   /* RELA */
+#define BENCH_MACHINE           EM_AARCH64
+#define BENCH_RET               0xd65f03c0  /* ret */
+#else
+#define BENCH_WITH_ADDEND       0   /* REL, the addend in the place */
+#define BENCH_MACHINE           EM_ARM
+#define BENCH_RET               0xe12fff1e  /* bx lr */
+#endif
+
+/* the sections of the objects built by make_object, by index */
+enum { BENCH_TEXT = 1, BENCH_DATA, BENCH_REL, BENCH_SYMTAB, BENCH_STRTAB,
+       BENCH_SHSTRTAB, BENCH_N_SHDRS };
+
+/*
+ * A relocatable object for the benchmarks and tests: a text and a data
+ * section, the relocations for one of them, and a symbol table.  Symbols are
+ * given without the null symbol, locals first; relocations are ElfRela with
+ * BENCH_WITH_ADDEND, ElfRel otherwise.
+ */
+typedef struct _bench_object {
+    size_t         text_size;
+    size_t         data_size;
+    const ElfSym * syms;
+    size_t         nsyms;
+    const char   * strtab;      /* starts with "\0" */
+    size_t         strtab_size;
+    const void   * rels;
+    size_t         nrels;
+    unsigned       rel_section; /* BENCH_TEXT or BENCH_DATA */
+} bench_object;
+
+/* The image (malloc'd), zero filled but for the tables; *text is where the
+ * text goes. */
+uint8_t *
+make_object(const bench_object * o, uint8_t ** text, size_t * image_size);
+
+#endif //LINK_BENCH_H
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <sys/mman.h>
+#include "CodeArena.h"
+#include "debug.h"
+
+static size_t
+round_up(size_t x, size_t alignment) {
+    return (x + alignment - 1) & ~(alignment - 1);
+}
+
+/*
+ * Take size bytes off the window, at the given (absolute) alignment.  Called
+ * with the lock held.
+ */
+static addr_t
+window_take(code_arena * arena, size_t size, size_t alignment) {
+    if(arena->window == 0x0)
+        return 0x0;
+    size_t offset = round_up(arena->window + arena->window_used, alignment)
+                    - arena->window;
+    if(offset + size > arena->window_size) {
+        arena->window_overflows++;
+        return 0x0;
+    }
+    arena->window_used = offset + size;
+    return arena->window + offset;
+}
+
+/* MAP_HUGETLB hands out huge page aligned memory, or nothing */
+static addr_t
+map_hugetlb(size_t size, addr_t at) {
+#if defined(MAP_HUGETLB)
+    void * mem = mmap((void*)at, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                      MAP_ANON | MAP_PRIVATE | MAP_HUGETLB
+                      | (at != 0x0 ? MAP_FIXED : 0), -1, 0);
+    if(mem != MAP_FAILED)
+        return (addr_t)mem;
+    link_log(LINK_LOG_WARN, LINK_LOG_MEMORY,
+             "MAP_HUGETLB of %lu bytes failed. errno = %d\n",
+             (unsigned long)size, errno);
+#else
+    (void)size;
+    (void)at;
+#endif
+    return 0x0;
+}
+
+/*
+ * Map at the given (huge page aligned) address in the window; otherwise,
+ * over-allocate by a huge page, and trim to huge page alignment.
+ */
+static addr_t
+map_aligned(size_t size, addr_t at) {
+    if(at != 0x0) {
+        void * mem = mmap((void*)at, size, PROT_READ | PROT_WRITE,
+                          MAP_ANON | MAP_PRIVATE | MAP_FIXED, -1, 0);
+        if(mem != MAP_FAILED)
+            return (addr_t)mem;
+        link_log(LINK_LOG_WARN, LINK_LOG_MEMORY,
+                 "failed to mmap %lu bytes of the window. errno = %d\n",
+                 (unsigned long)size, errno);
+        return 0x0;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t slack = HUGE_PAGE_SIZE - page;
+    uint8_t * mem = mmap(NULL, size + slack, PROT_READ | PROT_WRITE,
+                         MAP_ANON | MAP_PRIVATE, -1, 0);
+    if(mem == MAP_FAILED) {
+        link_log(LINK_LOG_WARN, LINK_LOG_MEMORY,
+                 "failed to mmap %lu bytes for text. errno = %d\n",
+                 (unsigned long)(size + slack), errno);
+        return 0x0;
+    }
+    addr_t start = round_up((addr_t)mem, HUGE_PAGE_SIZE);
+    size_t head = start - (addr_t)mem;
+    if(head > 0)
+        munmap(mem, head);
+    if(slack - head > 0)
+        munmap((void*)(start + size), slack - head);
+    return start;
+}
+
+static code_region *
+new_region(code_arena * arena, size_t size, bool try_hugetlb) {
+    size = round_up(size, HUGE_PAGE_SIZE);
+    code_region * r = calloc(1, sizeof(code_region));
+    assert(r != NULL);
+    r->size = size;
+    addr_t at = window_take(arena, size, HUGE_PAGE_SIZE);
+
+    if(try_hugetlb) {
+        r->start = map_hugetlb(size, at);
+        r->hugetlb = r->start != 0x0;
+        if(r->hugetlb)
+            arena->hugetlb_regions++;
+        else
+            arena->hugetlb_fallbacks++;
+    }
+    if(r->start == 0x0) {
+        r->start = map_aligned(size, at);
+        if(r->start == 0x0) {
+            free(r);
+            return NULL;
+        }
+#if defined(MADV_HUGEPAGE)
+        if(0 == madvise((void*)r->start, size, MADV_HUGEPAGE))
+            arena->thp_regions++;
+        else
+#endif
+            arena->madvise_failures++;
+    }
+
+    r->next = arena->regions;
+    arena->regions = r;
+    return r;
+}
+
+/* the first object dl_iterate_phdr reports is the main executable */
+static int
+first_object_base(struct dl_phdr_info * info, size_t size, void * data) {
+    (void)size;
+    addr_t lowest = ~(addr_t)0;
+    for(int i = 0; i < info->dlpi_phnum; i++)
+        if(info->dlpi_phdr[i].p_type == PT_LOAD
+           && info->dlpi_phdr[i].p_vaddr < lowest)
+            lowest = info->dlpi_phdr[i].p_vaddr;
+    if(lowest != ~(addr_t)0)
+        *(addr_t *)data = info->dlpi_addr + lowest;
+    return 1;
+}
+
+/* the base of the object containing anchor, or of the main executable */
+static addr_t
+host_base(void * anchor) {
+    addr_t base = 0x0;
+    Dl_info info;
+    if(anchor == NULL)
+        dl_iterate_phdr(first_object_base, &base);
+    else if(dladdr(anchor, &info))
+        base = (addr_t)info.dli_fbase;
+    return base;
+}
+
+/*
+ * Near the host, the window ends where the host begins.  Only half the range
+ * is used for the window, which leaves the other half to reach into the
+ * host's text.
+ */
+bool
+code_arena_reserve(code_arena * arena, bool near_host, void * anchor) {
+    pthread_mutex_lock(&arena->lock);
+    if(arena->window == 0x0) {
+        size_t size = NEAR_CODE_WINDOW;
+        addr_t hint = 0x0;
+        addr_t base = near_host ? host_base(anchor) : 0x0;
+        if(base > NEAR_CODE_WINDOW) {
+            size /= 2;
+            hint = base - size; /* both page aligned */
+        }
+        void * mem = mmap((void*)hint, size, PROT_NONE,
+                          MAP_ANON | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+        if(mem == MAP_FAILED) {
+            link_log(LINK_LOG_WARN, LINK_LOG_MEMORY,
+                     "failed to reserve %lu bytes for code. errno = %d\n",
+                     (unsigned long)size, errno);
+        } else {
+            arena->window      = (addr_t)mem;
+            arena->window_size = size;
+            arena->window_used = 0;
+            arena->window_near = hint != 0x0 && (addr_t)mem == hint;
+        }
+    }
+    bool r = arena->window == 0x0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    pthread_mutex_unlock(&arena->lock);
+    return r;
+}
+
+addr_t
+code_arena_map(code_arena * arena, size_t size) {
+    size = round_up(size, (size_t)sysconf(_SC_PAGESIZE));
+
+    pthread_mutex_lock(&arena->lock);
+    addr_t start = window_take(arena, size, 1);
+    if(start != 0x0)
+        arena->bytes += size;
+    pthread_mutex_unlock(&arena->lock);
+
+    if(start != 0x0
+       && 0 != mprotect((void*)start, size, PROT_READ | PROT_WRITE)) {
+        link_log(LINK_LOG_WARN, LINK_LOG_MEMORY,
+                 "failed to mprotect %lu bytes of the window. errno = %d\n",
+                 (unsigned long)size, errno);
+        return 0x0;
+    }
+    return start;
+}
+
+addr_t
+code_arena_alloc(code_arena * arena, size_t size, bool try_hugetlb,
+                 bool * hugetlb) {
+    size = round_up(size, (size_t)sysconf(_SC_PAGESIZE));
+
+    pthread_mutex_lock(&arena->lock);
+    code_region * r = arena->regions;
+    while(r != NULL && r->size - r->used < size)
+        r = r->next;
+    if(r == NULL)
+        r = new_region(arena, size, try_hugetlb);
+
+    addr_t start = 0x0;
+    if(r != NULL) {
+        start = r->start + r->used;
+        r->used += size;
+        arena->bytes += size;
+        *hugetlb = r->hugetlb;
+    }
+    pthread_mutex_unlock(&arena->lock);
+    return start;
+}
+
+void
+code_arena_free(code_arena * arena) {
+    code_region * r = arena->regions;
+    while(r != NULL) {
+        code_region * next = r->next;
+        munmap((void*)r->start, r->size);
+        free(r);
+        r = next;
+    }
+    arena->regions = NULL;
+    if(arena->window != 0x0)
+        munmap((void*)arena->window, arena->window_size);
+    arena->window = 0x0;
+}
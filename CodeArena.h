@@ -0,0 +1,108 @@
+#ifndef LINK_CODE_ARENA_H
+#define LINK_CODE_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "Types.h"
+
+/*
+ * Memory for the loaded segments of a linker session.
+ *
+ * With LOAD_NEAR_CODE, a window of NEAR_CODE_WINDOW bytes of address space is
+ * reserved up front, and all segments of all objects are allocated from it,
+ * so that any b/bl within the session is in range, and needs no stub.  Only
+ * branches out of the session (into system libraries, say) still go through
+ * stubs; the window can be placed near the host (the main executable, or the
+ * object of the embedder's choice) to make those direct, too.  Once the window is full, objects are mapped
+ * anywhere again.
+ *
+ * Huge page backed memory for the text segments (text and stubs); see
+ * LOAD_HUGE_TEXT.
+ *
+ * Segments are handed out page aligned from regions made of whole (2 MiB)
+ * huge pages.  Regions are madvise'd MADV_HUGEPAGE (transparent huge pages),
+ * or mapped MAP_HUGETLB if asked for and the system has huge pages reserved.
+ *
+ * The per object mprotect splits a transparent huge page; khugepaged
+ * collapses it again once all text in it is protected alike.  MAP_HUGETLB
+ * pages however can only be protected as a whole; these regions are mapped
+ * read-write-execute, and segments allocated from them are never mprotect'ed.
+ *
+ * Allocation takes the arena's lock, as objects may be parsed in parallel.  A
+ * zero initialized arena is empty.  Regions live as long as the arena.
+ */
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/* the range of b/bl: +-128 MiB on arm64, +-32 MiB on arm; any two addresses
+ * in the window are in range of these.  Not so of thumb bl/b.w (+-16 MiB) or
+ * b<c>.w (+-1 MiB): veneers check each branch's own range (elf/veneer.h) */
+#if defined(__aarch64__) || defined(__x86_64__)
+#define NEAR_CODE_WINDOW ((size_t)128 << 20)
+#else
+#define NEAR_CODE_WINDOW ((size_t)32 << 20)
+#endif
+
+typedef struct _code_region {
+    addr_t start;   /* huge page aligned */
+    size_t size;    /* a multiple of HUGE_PAGE_SIZE */
+    size_t used;
+    bool   hugetlb;
+    struct _code_region * next;
+} code_region;
+
+typedef struct _code_arena {
+    pthread_mutex_t lock;
+    code_region * regions;
+
+    /* the reserved window; 0x0 if none */
+    addr_t window;
+    size_t window_size;
+    size_t window_used;
+    bool   window_near;              /* placed near the host */
+    unsigned long window_overflows;  /* allocations that did not fit */
+
+    unsigned long thp_regions;       /* madvise'd MADV_HUGEPAGE */
+    unsigned long hugetlb_regions;   /* mapped MAP_HUGETLB */
+    unsigned long hugetlb_fallbacks; /* MAP_HUGETLB failed; THP instead */
+    unsigned long madvise_failures;  /* no THP either; plain pages */
+    size_t        bytes;             /* handed out */
+} code_arena;
+
+/*
+ * Reserve the near code window, if not reserved yet; near the host if asked
+ * to.  The host is the object containing anchor (a function of the host, say),
+ * or the main executable if anchor is NULL; not liblink itself, which may be a
+ * shared library of its own.  Returns EXIT_FAILURE if no address space could
+ * be reserved.
+ */
+bool
+code_arena_reserve(code_arena * arena, bool near_host, void * anchor);
+
+/*
+ * Allocate size bytes (rounded up to whole pages), read-write and zero
+ * filled, from the window.  Returns 0x0 if there is no window, or if it is
+ * full.
+ */
+addr_t
+code_arena_map(code_arena * arena, size_t size);
+
+/*
+ * Allocate size bytes (rounded up to whole pages), read-write, from the
+ * first huge page region with room; maps a new region (from the window, if
+ * there is room) if there is none.  *hugetlb is set if the memory is from a
+ * MAP_HUGETLB region (and hence rwx).  Returns 0x0 if no memory could be
+ * mapped.
+ */
+addr_t
+code_arena_alloc(code_arena * arena, size_t size, bool try_hugetlb,
+                 bool * hugetlb);
+
+/*
+ * Unmap all regions and the window.  Nothing allocated from the arena may be
+ * used after.
+ */
+void
+code_arena_free(code_arena * arena);
+
+#endif //LINK_CODE_ARENA_H
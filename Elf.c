@@ -1,15 +1,22 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "Linker.h"
 #include "Elf.h"
+#include "Pool.h"
 #include "elf/plt.h"
 #include "elf/got.h"
 #include "elf/reloc.h"
+#include "elf/reloc/util.h"
+#include "elf/reloc/decode.h"
 #include "debug.h"
 
 /*
@@ -118,7 +125,89 @@ mkOc(char *path, uint8_t *image, long imageSize,
     return oc;
 }
 
+/*
+ * Release an object's memory: its mappings (but those from the session's
+ * code arena, which go with the arena), GOT, tables, and its image, unless
+ * borrowed.  The object must not be on any list anymore, nor its symbols in
+ * the global symbol table; see linkerFree.
+ */
 void
+freeObjectCode(Linker * l, ObjectCode * oc) {
+    ObjectCodeFormatInfo * info = oc->info;
+    if(info != NULL) {
+        bool in_window = l->code.window != 0x0
+                         && info->mapping >= l->code.window
+                         && info->mapping < l->code.window
+                                            + l->code.window_size;
+        if(info->mapping_size > 0 && !in_window)
+            munmap((void*)info->mapping, info->mapping_size);
+        free_got(oc);
+
+        for(ElfSymbolTable *t = info->symbolTables; t != NULL; ) {
+            ElfSymbolTable * next = t->next;
+            free(t->symbols);
+            free(t);
+            t = next;
+        }
+        for(ElfRelocationTable *t = info->relTable; t != NULL; ) {
+            ElfRelocationTable * next = t->next;
+            free(t);
+            t = next;
+        }
+        for(ElfRelocationATable *t = info->relaTable; t != NULL; ) {
+            ElfRelocationATable * next = t->next;
+            free(t);
+            t = next;
+        }
+        if(info->deferred != NULL) {
+            free_decoded_relocations(info->deferred);
+            free(info->deferred);
+        }
+        free(info->symbolsByAddr);
+        free(info->stubDemand);
+        free(info->tables);
+        free(info);
+    }
+    for(unsigned i = 0; oc->sections != NULL && i < oc->n_sections; i++) {
+        if(oc->sections[i].info == NULL)
+            continue;
+        free_stubs(&oc->sections[i]);
+        free(oc->sections[i].info);
+    }
+    free(oc->sections);
+    free(oc->symbols);
+
+    /* published objects have released theirs already */
+    if(oc->image != NULL && oc->imageMapped)
+        munmap(oc->image, (size_t)oc->fileSize);
+    else if(!oc->imageBorrowed)
+        free(oc->image);
+    free(oc->fileName);
+    free(oc->archiveMemberName);
+    free(oc);
+}
+
+/*
+ * Only global and weak symbols (defined or not) take part in symbol
+ * resolution by name.  Local symbols, including file and section symbols, are
+ * resolved by index; hashing their names would be wasted work.
+ */
+static bool
+needs_name_hash(ElfSym * sym) {
+    switch(ELF_ST_TYPE(sym->st_info)) {
+        case STT_FILE:
+        case STT_SECTION:
+            return false;
+        default:
+            return ELF_ST_BIND(sym->st_info) != STB_LOCAL;
+    }
+}
+
+/*
+ * Parse the object's headers, and symbol and relocation tables.  This does
+ * not touch the linker session; names are interned by intern_symbol_names.
+ */
+static void
 ocInit(ObjectCode * oc)
 {
     oc->info = calloc(1, sizeof(ObjectCodeFormatInfo));
@@ -213,7 +302,10 @@ ocInit(ObjectCode * oc)
                     symbol->name = "(no name)";
                 } else {
                     symbol->name = symTab->names + symbol->elf_sym->st_name;
-                    symbol->hash = hash(symbol->name);
+                    if(needs_name_hash(symbol->elf_sym)) {
+                        symbol->hash = hash(symbol->name);
+                        symbol->hash_valid = true;
+                    }
                 }
                 /* we don't have an address for this symbol yet; this will be
                  * populated during ocGetNames. hence addr = NULL.
@@ -232,20 +324,183 @@ ocInit(ObjectCode * oc)
             }
         }
     }
+
+    /* bind the relocation tables to their symbol tables (sh_link), which may
+     * come after them; relocation then indexes straight into the symbols */
+    for(ElfRelocationTable *t = oc->info->relTable; t != NULL; t = t->next)
+        t->symbolTable = find_symbol_table(oc, t->sectionHeader->sh_link);
+    for(ElfRelocationATable *t = oc->info->relaTable; t != NULL; t = t->next)
+        t->symbolTable = find_symbol_table(oc, t->sectionHeader->sh_link);
 }
 
-ObjectCode *
-processObject(Linker * l, ObjectCode * oc ) {
+/*
+ * Resolution compares the names of symbols hashed by ocInit by pointer;
+ * intern them.
+ */
+static void
+intern_symbol_names(Linker * l, ObjectCode * oc) {
+    for(ElfSymbolTable *symTab = oc->info->symbolTables;
+        symTab != NULL; symTab = symTab->next) {
+        for(size_t j=0; j < symTab->n_symbols; j++) {
+            ElfSymbol * symbol = &symTab->symbols[j];
+            if(symbol->hash_valid) {
+                symbol->name = (SymbolName *)intern_name(
+                        &l->names, symbol->name, symbol->hash);
+                l->stats.hashes_computed++;
+            } else if(symbol->elf_sym->st_name != 0) {
+                l->stats.hashes_deferred++;
+            }
+        }
+    }
+}
+
+static size_t
+align_up(size_t x, size_t alignment);
+
+/* copy n bytes to *p, and advance *p past them, aligned */
+static void *
+copy_out(uint8_t ** p, const void * src, size_t n) {
+    void * dst = *p;
+    if(n > 0)
+        memcpy(dst, src, n);
+    *p += align_up(n, sizeof(addr_t));
+    return dst;
+}
+
+static char *
+copy_name(char ** p, const char * name) {
+    char * dst = *p;
+    size_t n = strlen(name) + 1;
+    memcpy(dst, name, n);
+    *p += n;
+    return dst;
+}
+
+/*
+ * Once its names are interned, an object needs nothing of its image but the
+ * tables resolution, symbolization and the symbol index read: the section
+ * headers, the symbols, the relocations, and the names that are not interned
+ * (those of the sections and of local symbols).  These are copied into one
+ * block, and the image is let go of: unmapped, freed, or left to the embedder
+ * if borrowed.  Sections that were not loaded pointed into the image; they
+ * are left without memory.
+ */
+static void
+release_image(Linker * l, ObjectCode * oc) {
+    ObjectCodeFormatInfo * info = oc->info;
+    const size_t a = sizeof(addr_t);
+
+    size_t size = align_up(oc->n_sections * sizeof(ElfShdr), a);
+    for(ElfSymbolTable *t = info->symbolTables; t != NULL; t = t->next)
+        size += align_up(t->n_symbols * sizeof(ElfSym), a);
+    for(ElfRelocationTable *t = info->relTable; t != NULL; t = t->next)
+        size += align_up(t->n_relocations * sizeof(ElfRel), a);
+    for(ElfRelocationATable *t = info->relaTable; t != NULL; t = t->next)
+        size += align_up(t->n_relocations * sizeof(ElfRela), a);
+    for(unsigned i = 0; i < oc->n_sections; i++)
+        size += strlen(oc->sections[i].info->name) + 1;
+    for(ElfSymbolTable *t = info->symbolTables; t != NULL; t = t->next)
+        for(size_t j = 0; j < t->n_symbols; j++) {
+            ElfSymbol * symbol = &t->symbols[j];
+            if(!symbol->hash_valid && symbol->elf_sym->st_name != 0)
+                size += strlen(symbol->name) + 1;
+        }
+
+    uint8_t * block = malloc(size), * p = block;
+    assert(block != NULL);
+
+    /* only parsing goes by the offsets in the ELF header */
+    info->elfHeader = NULL;
+    info->programHeader = NULL;
+    ElfShdr * shdr = copy_out(&p, info->sectionHeader,
+                              oc->n_sections * sizeof(ElfShdr));
+    for(ElfRelocationTable *t = info->relTable; t != NULL; t = t->next)
+        t->sectionHeader = shdr + (t->sectionHeader - info->sectionHeader);
+    for(ElfRelocationATable *t = info->relaTable; t != NULL; t = t->next)
+        t->sectionHeader = shdr + (t->sectionHeader - info->sectionHeader);
+    for(unsigned i = 0; i < oc->n_sections; i++)
+        oc->sections[i].info->sectionHeader = &shdr[i];
+    info->sectionHeader = shdr;
+
+    for(ElfSymbolTable *t = info->symbolTables; t != NULL; t = t->next) {
+        ElfSym * syms = copy_out(&p, t->n_symbols > 0
+                                     ? t->symbols[0].elf_sym : NULL,
+                                 t->n_symbols * sizeof(ElfSym));
+        for(size_t j = 0; j < t->n_symbols; j++)
+            t->symbols[j].elf_sym = &syms[j];
+        t->names = NULL;
+    }
+    for(ElfRelocationTable *t = info->relTable; t != NULL; t = t->next)
+        t->relocations = copy_out(&p, t->relocations,
+                                  t->n_relocations * sizeof(ElfRel));
+    for(ElfRelocationATable *t = info->relaTable; t != NULL; t = t->next)
+        t->relocations = copy_out(&p, t->relocations,
+                                  t->n_relocations * sizeof(ElfRela));
+
+    char * names = (char *)p;
+    for(unsigned i = 0; i < oc->n_sections; i++)
+        oc->sections[i].info->name = copy_name(&names,
+                                               oc->sections[i].info->name);
+    info->sectionHeaderStrtab = NULL;
+    for(ElfSymbolTable *t = info->symbolTables; t != NULL; t = t->next)
+        for(size_t j = 0; j < t->n_symbols; j++) {
+            ElfSymbol * symbol = &t->symbols[j];
+            if(!symbol->hash_valid && symbol->elf_sym->st_name != 0)
+                symbol->name = copy_name(&names, symbol->name);
+        }
+    assert((uint8_t *)names == block + size);
+    info->tables = block;
+
+    for(unsigned i = 0; i < oc->n_sections; i++)
+        if(oc->sections[i].alloc == SECTION_NOMEM) {
+            oc->sections[i].start = 0x0;
+            oc->sections[i].size  = 0;
+        }
+
+    l->stats.image_tables_kept += size;
+    if(!oc->imageBorrowed) {
+        l->stats.images_released++;
+        l->stats.image_bytes_released += (unsigned long)oc->fileSize;
+    }
+    if(oc->imageMapped)
+        munmap(oc->image, (size_t)oc->fileSize);
+    else if(!oc->imageBorrowed)
+        free(oc->image);
+    oc->image = NULL;
+}
+
+/*
+ * Everything up to symbol publication only concerns the object itself, and
+ * can be done for several objects in parallel.
+ */
+static void
+parseObject(Linker * l, ObjectCode * oc) {
+    oc->loadFlags = l->loadFlags;
     ocInit( oc );
 
-    if(load_sections(oc)) abort();
+    if(load_sections(l, oc)) abort();
+
+    if(make_got(oc)) abort();
+}
+
+/*
+ * Publish a parsed object's symbols, append it to the known objects, and
+ * queue its address ranges; the caller commits them (see AddrIndex.h).  The
+ * image is released first.
+ */
+static ObjectCode *
+publishObject(Linker * l, ObjectCode * oc) {
+    linker_lock(l);
+    intern_symbol_names(l, oc);
+    release_image(l, oc);
+    l->stats.readonly_file_mapped += oc->info->file_mapped;
 
     // get *all* names.
     if(get_names(l, oc)) abort();
 
-    if(make_got(oc)) abort();
+    addr_index_add_object(&l->ranges, oc);
 
-    /* prepend oc to the known objects */
+    /* append oc to the known objects */
     if(l->objects == NULL) l->objects = oc;
     else {
         ObjectCode * tail = l->objects;
@@ -253,6 +508,17 @@ processObject(Linker * l, ObjectCode * oc ) {
         assert(tail->next == NULL);
         tail->next = oc;
     }
+    linker_unlock(l);
+    return oc;
+}
+
+ObjectCode *
+processObject(Linker * l, ObjectCode * oc ) {
+    parseObject(l, oc);
+    linker_lock(l);
+    publishObject(l, oc);
+    addr_index_commit(&l->ranges);
+    linker_unlock(l);
     return oc;
 }
 
@@ -260,7 +526,9 @@ ObjectCode *
 loadObject(Linker * l, char * name __attribute__((unused)), char * path) {
     struct stat st;
     if(stat(path, &st)) {
-        __link_log("Failed to call stat(%s);\n", path); abort();
+        link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                 "Failed to call stat(%s);\n", path);
+        abort();
     }
     long fileSize = st.st_size;
     int fd = open(path, O_RDONLY);
@@ -269,7 +537,8 @@ loadObject(Linker * l, char * name __attribute__((unused)), char * path) {
     uint8_t * image = mmap(NULL, (size_t)fileSize, PROT_READ,
                            MAP_PRIVATE, fd, 0);
     if (image == MAP_FAILED) {
-        __link_log("mmap: failed. errno = %d", errno);
+        link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                 "mmap: failed. errno = %d", errno);
         abort();
     }
 
@@ -282,9 +551,94 @@ loadObject(Linker * l, char * name __attribute__((unused)), char * path) {
     return oc;
 }
 
+/* everything parsing relies on, before parsing; the image may be anything */
+static bool
+is_loadable_image(uint8_t * image, size_t size) {
+    if(size < sizeof(ElfEhdr) || 0 != memcmp(image, ELFMAG, SELFMAG))
+        return false;
+    ElfEhdr * ehdr = (ElfEhdr *)image;
+    if(ehdr->e_ident[EI_CLASS] != (sizeof(addr_t) == 8 ? ELFCLASS64
+                                                        : ELFCLASS32)
+       || ehdr->e_ident[EI_DATA] != ELFDATA2LSB
+       || ehdr->e_type != ET_REL
+       || ehdr->e_machine != ELF_MACHINE
+       || ehdr->e_shentsize != sizeof(ElfShdr))
+        return false;
+    /* the section headers fit, written not to overflow; section 0 is read
+     * for the count, if it is too large for e_shnum */
+    if(ehdr->e_shoff > size
+       || (size - ehdr->e_shoff) / sizeof(ElfShdr) < 1)
+        return false;
+    ElfShdr * shdr = (ElfShdr *)(image + ehdr->e_shoff);
+    if(ehdr->e_shnum == SHN_UNDEF && shdr[0].sh_size == 0)
+        return false;
+    size_t shnum = elf_shnum(ehdr);
+    return shnum <= (size - ehdr->e_shoff) / sizeof(ElfShdr)
+        /* SHN_XINDEX is not supported */
+        && ehdr->e_shstrndx < shnum;
+}
+
+ObjectCode *
+loadObjectFromMemory(Linker * l, const char * name, uint8_t * image,
+                     size_t size, ImageOwnership ownership) {
+    if(!is_loadable_image(image, size)) {
+        link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                 "%s: not a relocatable ELF object\n", name);
+        return NULL;
+    }
+    /* the tables are used in place; they need their natural alignment */
+    if(ownership != IMAGE_COPY && 0 != ((uintptr_t)image & (sizeof(addr_t) - 1))) {
+        /* malloc would not have returned it; it is not ours to free */
+        if(ownership == IMAGE_ADOPT) {
+            link_log(LINK_LOG_ERROR, LINK_LOG_LOAD,
+                     "%s: misaligned image, can't adopt it\n", name);
+            return NULL;
+        }
+        link_log(LINK_LOG_WARN, LINK_LOG_LOAD,
+                 "%s: misaligned image, copying it\n", name);
+        ownership = IMAGE_COPY;
+    }
+    if(ownership == IMAGE_COPY) {
+        uint8_t * copy = malloc(size);
+        assert(copy != NULL);
+        memcpy(copy, image, size);
+        image = copy;
+    }
+
+    ObjectCode * oc = mkOc((char *)name, image, (long)size, false, NULL, 0);
+    oc->imageFromMemory = true;
+    oc->imageBorrowed   = ownership == IMAGE_BORROW;
+
+    processObject(l, oc);
+
+    return oc;
+}
+
+typedef struct _parse_queue {
+    Linker * l;
+    ObjectCode ** ocs;
+    size_t n;
+    size_t next;   /* the next member to be claimed by a worker */
+} parse_queue;
+
+static void *
+parse_members(void * arg) {
+    parse_queue * q = arg;
+    for(size_t i = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED);
+        i < q->n;
+        i = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED))
+        parseObject(q->l, q->ocs[i]);
+    return NULL;
+}
+
 ObjectCode *
 loadArchive(Linker * l, char * path) {
-    __link_log("Loading Archive: %s...\n", path);
+    return loadArchiveParallel(l, path, 1);
+}
+
+ObjectCode *
+loadArchiveParallel(Linker * l, char * path, unsigned nthreads) {
+    link_log(LINK_LOG_INFO, LINK_LOG_LOAD, "Loading Archive: %s...\n", path);
 
     unsigned os = count_objects(l);
 
@@ -293,35 +647,199 @@ loadArchive(Linker * l, char * path) {
     ObjectCode * fst = NULL;
 
     Object *objs = read_archive(ar);
-    for(Object *o=objs; o != NULL; o = o->next) {
-        ObjectCode *oc = mkOc(path, o->image, o->size, false, o->name, 0);
+    fclose(ar);
 
-        processObject(l, oc );
+    parse_queue q = { .l = l, .ocs = NULL, .n = 0, .next = 0 };
+    for(Object *o=objs; o != NULL; o = o->next)
+        q.n++;
+    q.ocs = calloc(q.n, sizeof(ObjectCode *));
+    assert(q.n == 0 || q.ocs != NULL);
+    size_t k = 0;
+    for(Object *o=objs; o != NULL; o = o->next, k++) {
+        q.ocs[k] = mkOc(path, o->image, o->size, false, o->name, 0);
+        q.ocs[k]->archiveMemberOffset = o->offset;
+    }
 
-        if(fst == NULL) fst = oc;
+    /* the members are parsed by nthreads workers (this thread included), but
+     * published in archive order; just like loading them one by one. */
+    if(nthreads < 1) nthreads = 1;
+    if(nthreads > q.n) nthreads = q.n > 0 ? (unsigned)q.n : 1;
+    pthread_t * workers = calloc(nthreads, sizeof(pthread_t));
+    assert(workers != NULL);
+    unsigned started = 0;
+    for(; started + 1 < nthreads; started++)
+        if(pthread_create(&workers[started], NULL, parse_members, &q))
+            break; /* the remaining threads pick up the slack */
+    parse_members(&q);
+    for(unsigned t = 0; t < started; t++)
+        pthread_join(workers[t], NULL);
+    free(workers);
+
+    linker_lock(l);
+    for(k = 0; k < q.n; k++) {
+        publishObject(l, q.ocs[k]);
+        if(fst == NULL) fst = q.ocs[k];
     }
-    fclose(ar);
+    addr_index_commit(&l->ranges);
+    linker_unlock(l);
+    free(q.ocs);
 
     unsigned os2 = count_objects(l);
 
-    __link_log("Loaded %d objects.\n", os2 - os);
+    link_log(LINK_LOG_INFO, LINK_LOG_LOAD, "Loaded %d objects.\n", os2 - os);
+    if(link_log_enabled(LINK_LOG_DEBUG, LINK_LOG_LOAD))
+        log_linker_stats(l);
     return fst;
 }
 
+/* see LinkerStats.stubs_reserved */
+static void
+count_stubs(Linker * l, ObjectCode * oc) {
+    for(unsigned i = 0; i < oc->n_sections; i++) {
+        SectionFormatInfo * info = oc->sections[i].info;
+        if(info->stub_size > 0)
+            l->stats.stubs_reserved += (info->stub_size - STUB_GAP) / STUB_SIZE;
+        l->stats.stubs_made += info->nstubs;
+    }
+}
+
+/* resolve, leaving the veneers made to be sealed by the caller */
+static bool
+resolve_object(Linker * l, ObjectCode * oc) {
+    bool r = EXIT_SUCCESS;
+    /* relocating twice would apply the addends twice */
+    if(oc->status != OBJECT_RESOLVED && oc->status != OBJECT_RESOLVING) {
+        if(link_log_enabled(LINK_LOG_DEBUG, LINK_LOG_RELOC)) {
+            char ocbuf[256]; memset(ocbuf, 0, sizeof(ocbuf));
+            get_oc_info(ocbuf, oc);
+            __link_log("%s: Resolving Object(s) ...\n", ocbuf);
+        }
+        if(   fill_got( l, oc )
+           || verify_got( l, oc )
+           || relocate_object_code( l, oc )
+           || mprotect_object_code( oc ))
+            r = EXIT_FAILURE;
+        else {
+            oc->status = OBJECT_RESOLVED;
+            count_stubs(l, oc);
+        }
+    }
+    return r;
+}
+
 bool
 resolveObject(Linker * l, ObjectCode * oc) {
-    char ocbuf[256]; memset(ocbuf, 0, sizeof(ocbuf));
-    get_oc_info(ocbuf, oc);
-    __link_log("%s: Resolving Object(s) ...\n", ocbuf);
-    if(fill_got( l, oc ))
-        return EXIT_FAILURE;
-    if(verify_got( l, oc ))
-        return EXIT_FAILURE;
-    if(relocate_object_code( oc ))
-        return EXIT_FAILURE;
-    if(mprotect_object_code( oc ))
-        return EXIT_FAILURE;
-    return EXIT_SUCCESS;
+    linker_lock(l);
+    bool r = resolve_object(l, oc);
+    seal_veneers(&l->veneers);
+    linker_unlock(l);
+    return r;
+}
+
+bool
+resolvePending(Linker * l) {
+    linker_lock(l);
+    bool r = EXIT_SUCCESS;
+    /* resolving may load further objects from the symbol index; they are
+     * appended to the list, and picked up by this very loop. */
+    for(ObjectCode * oc = l->objects; oc != NULL && !r; oc = oc->next)
+        r = resolve_object(l, oc);
+    seal_veneers(&l->veneers);
+    linker_unlock(l);
+    return r;
+}
+
+typedef struct _resolve_job {
+    Linker     * l;
+    ObjectCode * oc;
+    OStatus      status;  /* before resolveAll claimed it */
+    bool         failed;
+} resolve_job;
+
+/* the per object stages; only lookups reach beyond the object */
+static void
+resolve_local(void * item, void * ctx __attribute__((unused))) {
+    resolve_job * job = item;
+    ObjectCode * oc = job->oc;
+    if(link_log_enabled(LINK_LOG_DEBUG, LINK_LOG_RELOC)) {
+        char ocbuf[256]; memset(ocbuf, 0, sizeof(ocbuf));
+        get_oc_info(ocbuf, oc);
+        __link_log("%s: Resolving Object(s) ...\n", ocbuf);
+    }
+    job->failed = fill_got(job->l, oc)
+                  || verify_got(job->l, oc)
+                  || relocate_object_code_local(job->l, oc)
+                  /* else protected once the deferred ones are done */
+                  || (oc->info->deferred == NULL && mprotect_object_code(oc));
+}
+
+/*
+ * Objects are resolved in rounds: the pending objects are claimed, and
+ * resolved by the pool, without the linker lock; lookups take it as usual.
+ * Objects loaded meanwhile (from the symbol index) make for another round.
+ * Whatever needs sharing is done after each round, in object order: the
+ * stubs made are registered as veneers, and the relocations deferred are
+ * applied.
+ */
+bool
+resolveAll(Linker * l, unsigned nthreads) {
+    linker_lock(l);
+    /* the workers would wait for a lock the caller holds */
+    if(l->lock_depth > 1 || nthreads < 1)
+        nthreads = 1;
+
+    bool r = EXIT_SUCCESS;
+    while(!r) {
+        size_t n = 0;
+        for(ObjectCode * oc = l->objects; oc != NULL; oc = oc->next)
+            if(oc->status != OBJECT_RESOLVED && oc->status != OBJECT_RESOLVING)
+                n++;
+        if(n == 0)
+            break;
+        resolve_job * jobs = calloc(n, sizeof(resolve_job));
+        void ** items = calloc(n, sizeof(void *));
+        assert(jobs != NULL && items != NULL);
+        size_t k = 0;
+        for(ObjectCode * oc = l->objects; oc != NULL && k < n; oc = oc->next) {
+            if(oc->status == OBJECT_RESOLVED || oc->status == OBJECT_RESOLVING)
+                continue;
+            jobs[k] = (resolve_job){ .l = l, .oc = oc, .status = oc->status };
+            items[k] = &jobs[k];
+            oc->status = OBJECT_RESOLVING;
+            k++;
+        }
+
+        if(nthreads > 1)
+            linker_unlock(l);
+        size_t stolen = pool_run(items, n, nthreads, resolve_local, NULL);
+        if(nthreads > 1)
+            linker_lock(l);
+        link_log(LINK_LOG_DEBUG, LINK_LOG_RELOC,
+                 "Resolved %lu objects on %u threads; %lu stolen\n",
+                 (unsigned long)n, nthreads, (unsigned long)stolen);
+
+        for(k = 0; k < n; k++)
+            if(!jobs[k].failed)
+                share_stubs(l, jobs[k].oc);
+        for(k = 0; k < n; k++) {
+            ObjectCode * oc = jobs[k].oc;
+            if(!jobs[k].failed && oc->info->deferred != NULL)
+                jobs[k].failed = relocate_deferred(l, oc)
+                                 || mprotect_object_code(oc);
+            if(jobs[k].failed) {
+                oc->status = jobs[k].status;
+                r = EXIT_FAILURE;
+            } else {
+                oc->status = OBJECT_RESOLVED;
+                count_stubs(l, oc);
+            }
+        }
+        free(items);
+        free(jobs);
+    }
+    seal_veneers(&l->veneers);
+    linker_unlock(l);
+    return r;
 }
 
 #define SHF_RO   SHF_ALLOC
@@ -392,161 +910,299 @@ debug_print_section(Section * s) {
 # error "NOT IMPLEMENTED"
 #endif
 
-bool
-load_sections(ObjectCode * oc) {
-    __link_log("Loading sections for %s (%s)\n",
-               oc->fileName,
-               oc->archiveMemberName == NULL ? "" : oc->archiveMemberName);
-    for(unsigned i=0; i < oc->n_sections; i++) {
-        ElfShdr * sectionHeader = &oc->info->sectionHeader[i];
-        SectionKind kind = section_kind(sectionHeader);
-        switch(kind) {
-            case SECTIONKIND_TEXT:
-            case SECTIONKIND_RODATA:
-            case SECTIONKIND_RWDATA: {
-                unsigned nstubs = numberOfStubsForSection(oc, i);
-                unsigned stub_space = STUB_SIZE * nstubs;
-
-                /* function stub relocation makes only sense in text sections */
-                assert(nstubs == 0 || kind == SECTIONKIND_TEXT);
-
-                if(sectionHeader->sh_size+stub_space == 0) {
-                    addSection(&oc->sections[i], kind, SECTION_NOMEM,
-                               0x0 /* mem */, 0 /* size */, 0 /* mapped off */,
-                               0x0 /* mapped start */, 0 /* mapped size */);
-
-                    oc->sections[i].info->name        = oc->info->sectionHeaderStrtab + sectionHeader->sh_name;
-                    oc->sections[i].info->nstubs      = 0;
-                    oc->sections[i].info->stub_offset = 0x0;
-                    oc->sections[i].info->stub_size   = 0;
-                    oc->sections[i].info->stubs       = 0x0;
-                } else {
-                    /* ensure we are word aligned for the stub space */
-                    assert(   0 == stub_space
-                           || 0 == (sectionHeader->sh_size & 0x3));
-                    void *mem = mmap(NULL, sectionHeader->sh_size + stub_space,
-                                     PROT_READ | PROT_WRITE,
-                                     MAP_ANON | MAP_PRIVATE,
-                                     -1, 0);
-
-                    addr_t stub_offset = (addr_t) mem + sectionHeader->sh_size;
-
-                    if (mem == MAP_FAILED) {
-                        __link_log(
-                                "failed to mmap allocated memory to load section %d. errno = %d",
-                                i, errno);
-                        abort();
-                    }
+/* the segment a section of the given kind is packed into, or -1 */
+static int
+segment_for(SectionKind kind) {
+    switch(kind) {
+        case SECTIONKIND_TEXT:     return SEGMENT_TEXT;
+        case SECTIONKIND_RODATA:   return SEGMENT_RODATA;
+        case SECTIONKIND_RWDATA:
+        case SECTIONKIND_ZEROFILL: return SEGMENT_RWDATA;
+        default:                   return -1;
+    }
+}
 
-                    /* copy the data from the image into the section memory */
-                    memcpy(mem,
-                           oc->image + sectionHeader->sh_offset,
-                           sectionHeader->sh_size);
+static const int segment_prot[N_SEGMENTS] = {
+        [SEGMENT_TEXT]   = PROT_READ | PROT_EXEC,
+        [SEGMENT_RODATA] = PROT_READ,
+        [SEGMENT_RWDATA] = PROT_READ | PROT_WRITE,
+};
 
-                    addSection(&oc->sections[i], kind, SECTION_MMAP,
-                               (addr_t)mem, (unsigned)sectionHeader->sh_size, 0,
-                               (addr_t)mem, (unsigned)sectionHeader->sh_size + stub_space);
+static size_t
+align_up(size_t x, size_t alignment) {
+    return alignment <= 1 ? x : (x + alignment - 1) & ~(alignment - 1);
+}
 
-                    oc->sections[i].info->name        = oc->info->sectionHeaderStrtab + sectionHeader->sh_name;
-                    oc->sections[i].info->nstubs      = 0;
-                    oc->sections[i].info->stub_offset = stub_offset;
-                    oc->sections[i].info->stub_size   = stub_space;
-                    oc->sections[i].info->stubs       = NULL;
-                }
+/* the offset of the section's contents in oc->fileName */
+static size_t
+file_offset(ObjectCode * oc, ElfShdr * sectionHeader) {
+    size_t base = oc->archiveMemberName == NULL
+                  ? 0 : (size_t)oc->archiveMemberOffset;
+    return base + sectionHeader->sh_offset;
+}
 
-                oc->sections[i].info->sectionHeader = sectionHeader;
+/*
+ * With LOAD_MAP_READONLY, read only sections of at least a page are mapped
+ * from the file instead of being copied.  The section is placed on pages of
+ * its own, at the same offset within the page as in the file; this only
+ * honours sh_addralign if the file offset does so, too.
+ */
+static bool
+maps_from_file(ObjectCode * oc, ElfShdr * sectionHeader, size_t page) {
+    if(!(oc->loadFlags & LOAD_MAP_READONLY) || oc->imageFromMemory)
+        return false;
+    if(section_kind(sectionHeader) != SECTIONKIND_RODATA
+       || sectionHeader->sh_size < page)
+        return false;
+    size_t align = sectionHeader->sh_addralign;
+    return align <= 1 || (file_offset(oc, sectionHeader) % page) % align == 0;
+}
 
-                break;
-            }
-            case SECTIONKIND_ZEROFILL: {
-                if(sectionHeader->sh_size > 0) {
-                    void *mem = mmap(NULL, sectionHeader->sh_size,
-                                     PROT_READ | PROT_WRITE,
-                                     MAP_ANON | MAP_PRIVATE,
-                                     -1, 0);
-
-                    if (mem == MAP_FAILED) {
-                        __link_log(
-                                "failed to mmap allocated memory to load section %d. errno = %d",
-                                i, errno);
-                        abort();
-                    }
+/*
+ * Map the pages of the file holding the section over its place in the
+ * mapping.  The private mapping stays writable until mprotect, such that
+ * relocations only copy the pages they touch.
+ */
+static bool
+map_from_file(int fd, ElfShdr * sectionHeader, size_t file_off,
+              addr_t start, size_t page) {
+    size_t skew = file_off % page;
+    size_t span = align_up(skew + sectionHeader->sh_size, page);
+    void * mem = mmap((void*)(start - skew), span, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_FIXED, fd, (off_t)(file_off - skew));
+    if(mem != MAP_FAILED)
+        return EXIT_SUCCESS;
+    /* put anonymous memory back, for the copy to go to */
+    mem = mmap((void*)(start - skew), span, PROT_READ | PROT_WRITE,
+               MAP_ANON | MAP_PRIVATE | MAP_FIXED, -1, 0);
+    if(mem == MAP_FAILED) {
+        link_log(LINK_LOG_ERROR, LINK_LOG_MEMORY,
+                 "failed to restore %lu bytes at %p. errno = %d\n",
+                 (unsigned long)span, (void*)(start - skew), errno);
+        abort();
+    }
+    return EXIT_FAILURE;
+}
 
-                    addSection(&oc->sections[i], kind, SECTION_MMAP,
-                               (addr_t)mem, (unsigned)sectionHeader->sh_size, 0,
-                               0x0, 0);
-                } else {
-                    // a zero sized section. calloc nothing, this will usually
-                    // result in a single allocated byte.
-                    void *mem = mmap(NULL, 1,
-                                     PROT_READ | PROT_WRITE,
-                                     MAP_ANON | MAP_PRIVATE,
-                                     -1, 0);
-
-                    if (mem == MAP_FAILED) {
-                        __link_log(
-                                "failed to mmap allocated memory to load section %d. errno = %d",
-                                i, errno);
-                        abort();
-                    }
+/*
+ * Lay out the sections: offsets relative to their segment, with room for
+ * stubs behind text sections if asked for.  Returns if any section is to be
+ * mapped from the file.
+ */
+static bool
+layout_sections(ObjectCode * oc, bool with_stubs, size_t page,
+                size_t * offset, size_t * stubs,
+                size_t segment_size[N_SEGMENTS]) {
+    bool from_file = false;
+    for(int seg = 0; seg < N_SEGMENTS; seg++)
+        segment_size[seg] = 0;
+    for(unsigned i=0; i < oc->n_sections; i++) {
+        ElfShdr * sectionHeader = &oc->info->sectionHeader[i];
+        SectionKind kind = section_kind(sectionHeader);
+        int seg = segment_for(kind);
+        offset[i] = 0;
+        stubs[i] = 0;
+        if(seg < 0)
+            continue;
+
+        size_t size = sectionHeader->sh_size;
+        if(kind == SECTIONKIND_TEXT && with_stubs) {
+            unsigned nstubs = numberOfStubsForSection(oc, i);
+            if(nstubs > 0)
+                stubs[i] = STUB_GAP + STUB_SIZE * nstubs;
+        }
+        /* function stub relocation makes only sense in text sections */
+        assert(stubs[i] == 0 || kind == SECTIONKIND_TEXT);
+
+        /* an empty bss still needs an address of its own */
+        if(kind == SECTIONKIND_ZEROFILL && size == 0)
+            size = 1;
+        if(size + stubs[i] == 0)
+            continue;
+
+        if(maps_from_file(oc, sectionHeader, page)) {
+            /* pages of its own, congruent to the file offset */
+            offset[i] = align_up(segment_size[seg], page)
+                        + file_offset(oc, sectionHeader) % page;
+            segment_size[seg] = align_up(offset[i] + size, page);
+            from_file = true;
+            continue;
+        }
 
-//                    void * mem = calloc(1, sectionHeader->sh_size);
-//                    assert(mem != NULL);
-                    addSection(&oc->sections[i], kind, SECTION_MALLOC,
-                               (addr_t)mem, 1/*sectionHeader->sh_size */, 0,
-                               0x0, 0);
-                }
+        size_t cursor = align_up(segment_size[seg],
+                                 (size_t)sectionHeader->sh_addralign);
+        offset[i] = cursor;
+        cursor += size;
+        if(stubs[i] > 0)
+            cursor = align_up(cursor, sizeof(addr_t)) + stubs[i];
+        segment_size[seg] = cursor;
+    }
+    return from_file;
+}
 
-                oc->sections[i].info->name        = oc->info->sectionHeaderStrtab + sectionHeader->sh_name;
-                oc->sections[i].info->nstubs      = 0;
-                oc->sections[i].info->stub_offset = 0x0;
-                oc->sections[i].info->stub_size   = 0;
-                oc->sections[i].info->stubs       = NULL;
+/* segment offsets in the object's mapping; returns the mapping's size */
+static size_t
+layout_segments(size_t segment_size[N_SEGMENTS], bool huge_text, size_t page,
+                size_t segment_offset[N_SEGMENTS]) {
+    size_t total = 0;
+    for(int seg = 0; seg < N_SEGMENTS; seg++) {
+        segment_offset[seg] = total;
+        if(seg == SEGMENT_TEXT && huge_text)
+            continue;
+        total += align_up(segment_size[seg], page);
+    }
+    return total;
+}
+
+/*
+ * Sections are not mapped one by one.  A layout pass packs all loaded
+ * sections (honouring sh_addralign), and the stubs of text sections right
+ * behind them, into one page aligned segment per protection class.  The
+ * object then gets a single mapping holding all of its segments, and
+ * mprotect_loaded_sections issues one mprotect per segment.
+ *
+ * Read only sections may be mapped from the file instead; see
+ * maps_from_file.  With LOAD_HUGE_TEXT, the text segment is not part of the
+ * object's mapping, but allocated from the session's huge page backed
+ * code arena.  With LOAD_NEAR_CODE, the mapping is allocated from the
+ * arena's window; out of range branches from the window go through shared
+ * veneers (see elf/veneer.h), and no stub space is reserved, unless the
+ * window is full (or the text goes to huge pages, which may be outside).
+ */
+bool
+load_sections(Linker * l, ObjectCode * oc) {
+    link_log(LINK_LOG_DEBUG, LINK_LOG_LOAD, "Loading sections for %s (%s)\n",
+             oc->fileName,
+             oc->archiveMemberName == NULL ? "" : oc->archiveMemberName);
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t * offset = calloc(oc->n_sections, sizeof(size_t));
+    size_t * stubs  = calloc(oc->n_sections, sizeof(size_t));
+    assert(oc->n_sections == 0 || (offset != NULL && stubs != NULL));
+
+    bool huge = 0 != (oc->loadFlags & (LOAD_HUGE_TEXT | LOAD_HUGETLB_TEXT));
+    bool near = 0 != (oc->loadFlags & (LOAD_NEAR_CODE | LOAD_NEAR_HOST))
+                && !code_arena_reserve(&l->code,
+                                       oc->loadFlags & LOAD_NEAR_HOST,
+                                       l->hostAnchor);
+
+    /* layout: offsets relative to the segment first, ... */
+    size_t segment_size[N_SEGMENTS];
+    bool from_file = layout_sections(oc, !near || huge, page, offset, stubs,
+                                     segment_size);
+
+    /* ... then the segments, each starting on a page of its own */
+    bool huge_text = huge && segment_size[SEGMENT_TEXT] > 0;
+    size_t segment_offset[N_SEGMENTS];
+    size_t total = layout_segments(segment_size, huge_text, page,
+                                   segment_offset);
+
+    uint8_t * mem = NULL;
+    if(total > 0 && near) {
+        mem = (uint8_t *)code_arena_map(&l->code, total);
+        if(mem == NULL && !huge) {
+            /* the window is full; reserve stub space after all */
+            from_file = layout_sections(oc, true, page, offset, stubs,
+                                        segment_size);
+            total = layout_segments(segment_size, huge_text, page,
+                                    segment_offset);
+        }
+    }
+    if(total > 0 && mem == NULL) {
+        mem = mmap(NULL, total, PROT_READ | PROT_WRITE,
+                   MAP_ANON | MAP_PRIVATE, -1, 0);
+        if (mem == MAP_FAILED) {
+            link_log(LINK_LOG_ERROR, LINK_LOG_MEMORY,
+                     "failed to mmap %lu bytes for the sections of %s. "
+                     "errno = %d", (unsigned long)total, oc->fileName, errno);
+            abort();
+        }
+    }
+    oc->info->mapping      = (addr_t)mem;
+    oc->info->mapping_size = total;
+    for(int seg = 0; seg < N_SEGMENTS; seg++) {
+        oc->info->segments[seg].start = (addr_t)mem + segment_offset[seg];
+        oc->info->segments[seg].size  = align_up(segment_size[seg], page);
+        oc->info->segments[seg].prot  = segment_prot[seg];
+        oc->info->segments[seg].rwx   = false;
+    }
+    if(huge_text) {
+        Segment * text = &oc->info->segments[SEGMENT_TEXT];
+        text->start = code_arena_alloc(&l->code, text->size,
+                                       oc->loadFlags & LOAD_HUGETLB_TEXT,
+                                       &text->rwx);
+        if(text->start == 0x0) {
+            link_log(LINK_LOG_ERROR, LINK_LOG_MEMORY,
+                     "failed to allocate %lu bytes of text for %s.\n",
+                     (unsigned long)text->size, oc->fileName);
+            abort();
+        }
+    }
 
-                oc->sections[i].info->sectionHeader = sectionHeader;
+    int fd = -1;
+    if(from_file) {
+        fd = open(oc->fileName, O_RDONLY);
+        if(fd < 0)
+            link_log(LINK_LOG_WARN, LINK_LOG_LOAD,
+                     "failed to open %s, copying its sections. errno = %d\n",
+                     oc->fileName, errno);
+    }
 
-                break;
-            }
-            default: {
-                addSection(&oc->sections[i], kind, SECTION_NOMEM,
-                           (addr_t)oc->image+sectionHeader->sh_offset,
-                           (unsigned)sectionHeader->sh_size,
-                           0, 0x0, 0);
-
-                oc->sections[i].info->name        = oc->info->sectionHeaderStrtab + sectionHeader->sh_name;
-                oc->sections[i].info->nstubs = 0;
-                oc->sections[i].info->stub_offset = 0x0;
-                oc->sections[i].info->stub_size = 0;
-                oc->sections[i].info->stubs = NULL;
-
-                oc->sections[i].info->sectionHeader = sectionHeader;
-
-//                char *info = elf_lookup_section_type(sectionHeader->sh_type);
-//                if (info) {
-//                   log("Ignoning section: %s\n", info);
-//                } else {
-//
-//                   log("Unknown section: 0x%0x (%s)\n",
-//                           sectionHeader->sh_type,
-//                           oc->info->sectionHeaderStrtab
-//                           + sectionHeader->sh_name);
-//
-//                }
-                break;
-            }
+    for(unsigned i=0; i < oc->n_sections; i++) {
+        ElfShdr * sectionHeader = &oc->info->sectionHeader[i];
+        SectionKind kind = section_kind(sectionHeader);
+        int seg = segment_for(kind);
+        size_t size = sectionHeader->sh_size;
+
+        if(seg < 0) {
+            addSection(&oc->sections[i], kind, SECTION_NOMEM,
+                       (addr_t)oc->image+sectionHeader->sh_offset,
+                       (unsigned)size,
+                       0, 0x0, 0);
+        } else if(size + stubs[i] == 0 && kind != SECTIONKIND_ZEROFILL) {
+            addSection(&oc->sections[i], kind, SECTION_NOMEM,
+                       0x0 /* mem */, 0 /* size */, 0 /* mapped off */,
+                       0x0 /* mapped start */, 0 /* mapped size */);
+        } else {
+            Segment * segment = &oc->info->segments[seg];
+            addr_t start = segment->start + offset[i];
+            /* the mapping is zero filled already */
+            if(fd >= 0 && maps_from_file(oc, sectionHeader, page)
+               && !map_from_file(fd, sectionHeader,
+                                 file_offset(oc, sectionHeader),
+                                 start, page))
+                oc->info->file_mapped += size;
+            else if(kind != SECTIONKIND_ZEROFILL)
+                memcpy((void*)start,
+                       oc->image + sectionHeader->sh_offset,
+                       size);
+            if(kind == SECTIONKIND_ZEROFILL && size == 0)
+                size = 1;
+            addSection(&oc->sections[i], kind, SECTION_MMAP,
+                       start, (unsigned)size, 0,
+                       segment->start, (unsigned)segment->size);
         }
-        /* debug */
-        switch(kind) {
-            case SECTIONKIND_TEXT:
-            case SECTIONKIND_RODATA:
-            case SECTIONKIND_RWDATA:
-            case SECTIONKIND_ZEROFILL:
-                debug_print_section(&oc->sections[i]);
-                break;
-            default:
-                break;
+
+        oc->sections[i].info->name        = oc->info->sectionHeaderStrtab + sectionHeader->sh_name;
+        oc->sections[i].info->nstubs      = 0;
+        oc->sections[i].info->stub_offset = 0x0;
+        oc->sections[i].info->stub_size   = 0;
+        oc->sections[i].info->stubs       = NULL;
+        oc->sections[i].info->stub_map    = NULL;
+        if(stubs[i] > 0) {
+            oc->sections[i].info->stub_offset
+                    = align_up(oc->sections[i].start + size, sizeof(addr_t));
+            oc->sections[i].info->stub_size = stubs[i];
         }
+        oc->sections[i].info->sectionHeader = sectionHeader;
+
+        if(seg >= 0 && link_log_enabled(LINK_LOG_TRACE, LINK_LOG_LOAD))
+            debug_print_section(&oc->sections[i]);
     }
+    if(fd >= 0)
+        close(fd);
+    free(offset);
+    free(stubs);
     return EXIT_SUCCESS;
 }
 
@@ -606,30 +1262,15 @@ is_section_symbol(ElfSymbol * symbol) {
 
 bool
 mprotect_loaded_sections(ObjectCode * oc) {
-    // mprotect sections
-    for(unsigned i=0; i < oc->n_sections; i++) {
-        if(oc->sections[i].alloc == SECTION_NOMEM) continue;
-
-        /* we can only mprotect mmaped sections */
-        if(!(oc->sections[i].alloc == SECTION_MMAP)) continue;
-
-        unsigned flags = PROT_NONE;
-        switch( oc->sections[i].kind ) {
-            case SECTIONKIND_ZEROFILL:
-            case SECTIONKIND_RWDATA:
-                flags = PROT_READ | PROT_WRITE;
-                break;
-            case SECTIONKIND_TEXT:
-                flags = PROT_READ | PROT_EXEC;
-                break;
-            default:
-                flags = PROT_READ;
-                break;
-        }
-
-        if(0 != mprotect((void*)oc->sections[i].mapped_start,
-                                oc->sections[i].mapped_size, flags)) {
-            __link_log("mprotect for section %d failed!", i);
+    // mprotect segments; see load_sections
+    for(int seg = 0; seg < N_SEGMENTS; seg++) {
+        Segment * segment = &oc->info->segments[seg];
+        if(segment->size == 0 || segment->rwx) continue;
+
+        if(0 != mprotect((void*)segment->start, segment->size,
+                         segment->prot)) {
+            link_log(LINK_LOG_ERROR, LINK_LOG_MEMORY,
+                     "mprotect for segment %d failed!", seg);
             return EXIT_FAILURE;
         }
     }
@@ -646,13 +1287,60 @@ mprotect_object_code(ObjectCode * oc) {
         if( mprotect((void*)oc->info->got_start,
                      oc->info->got_size,
                      PROT_READ | PROT_EXEC) ) {
-            __link_log("mprotect failed!");
+            link_log(LINK_LOG_ERROR, LINK_LOG_MEMORY, "mprotect failed!");
             return EXIT_FAILURE;
         }
     }
     return EXIT_SUCCESS;
 }
 
+static int
+compare_symbol_ranges(const void * a, const void * b) {
+    const SymbolRange * x = a, * y = b;
+    if(x->start != y->start)
+        return x->start < y->start ? -1 : 1;
+    /* keep aliases in symbol table order */
+    return x->symbol < y->symbol ? -1 : x->symbol > y->symbol ? 1 : 0;
+}
+
+/* index the object's defined, sized symbols by address */
+static void
+sort_symbols_by_addr(ObjectCode * oc) {
+    size_t n = 0;
+    for(ElfSymbolTable *symTab = oc->info->symbolTables;
+        symTab != NULL; symTab = symTab->next)
+        for(size_t j = 0; j < symTab->n_symbols; j++)
+            if(   0x0 != symTab->symbols[j].addr
+               && 0 != symTab->symbols[j].elf_sym->st_size)
+                n++;
+
+    SymbolRange * ranges = calloc(n, sizeof(SymbolRange));
+    assert(n == 0 || ranges != NULL);
+    size_t k = 0;
+    for(ElfSymbolTable *symTab = oc->info->symbolTables;
+        symTab != NULL; symTab = symTab->next) {
+        for(size_t j = 0; j < symTab->n_symbols; j++) {
+            ElfSymbol * symbol = &symTab->symbols[j];
+            if(0x0 == symbol->addr || 0 == symbol->elf_sym->st_size)
+                continue;
+            ranges[k].start  = symbol->addr;
+            ranges[k].size   = symbol->elf_sym->st_size;
+            ranges[k].symbol = symbol;
+            k++;
+        }
+    }
+    qsort(ranges, n, sizeof(SymbolRange), compare_symbol_ranges);
+    /* symbols may nest, or alias with different sizes */
+    addr_t reach = 0;
+    for(k = 0; k < n; k++) {
+        if(ranges[k].start + ranges[k].size > reach)
+            reach = ranges[k].start + ranges[k].size;
+        ranges[k].reach = reach;
+    }
+    oc->info->symbolsByAddr   = ranges;
+    oc->info->n_symbolsByAddr = n;
+}
+
 bool
 get_names(Linker * l, ObjectCode * oc) {
     oc->n_symbols = 0;
@@ -709,8 +1397,11 @@ get_names(Linker * l, ObjectCode * oc) {
                 /* we may end up with zero sized items */
 
                 assert(!is_weak(symbol));
-                symbol->addr = oc->sections[shndx].start
-                               + symbol->elf_sym->st_value;
+                /* sections that were not loaded have no memory (see
+                 * release_image); their symbols stay without an address */
+                if(oc->sections[shndx].start != 0x0)
+                    symbol->addr = oc->sections[shndx].start
+                                   + symbol->elf_sym->st_value;
             }
 
             if (0x0 != symbol->addr) {
@@ -736,5 +1427,6 @@ get_names(Linker * l, ObjectCode * oc) {
             }
         }
     }
+    sort_symbols_by_addr(oc);
     return EXIT_SUCCESS;
 }
\ No newline at end of file
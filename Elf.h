@@ -4,7 +4,14 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include "Types.h"
-#include "BinaryTree.h"
+#include "SymbolTable.h"
+
+ObjectCode *
+mkOc(char *path, uint8_t *image, long imageSize,
+     bool mapped, char *archiveMemberName, unsigned misalignment);
+
+ObjectCode *
+processObject(Linker * l, ObjectCode * oc);
 
 ObjectCode *
 loadObject(Linker * l, char * name, char * path);
@@ -12,15 +19,55 @@ loadObject(Linker * l, char * name, char * path);
 ObjectCode *
 loadArchive(Linker * l, char * path);
 
+/*
+ * loadArchive, with the members parsed, their sections loaded and GOTs
+ * allocated by nthreads threads.  Symbols are published in archive order;
+ * the result is the same as loadArchive's.
+ */
+ObjectCode *
+loadArchiveParallel(Linker * l, char * path, unsigned nthreads);
+
+/*
+ * Load an object from the embedder's memory, without a round trip through
+ * the file system.  Only section contents are copied (into the section
+ * mappings); headers, symbol, string and relocation tables are used in
+ * place while loading, unless the image is copied as a whole (IMAGE_COPY,
+ * or a borrowed image that is not aligned to an address).  The image is
+ * released before this returns: freed if adopted, handed back if borrowed.
+ * A misaligned image to adopt is rejected; it can't have come from malloc.
+ * name is used in place of a file name.  Returns NULL, leaving the image
+ * with the embedder, if the image is not an ELF object for this
+ * architecture, or its headers are out of bounds.
+ */
 ObjectCode *
-load_object( char * name, uint8_t * image);
+loadObjectFromMemory(Linker * l, const char * name, uint8_t * image,
+                     size_t size, ImageOwnership ownership);
+
+void
+freeObjectCode(Linker * l, ObjectCode * oc);
 
 bool
 resolveObject(Linker * l, ObjectCode * oc);
 
+/* Resolve all objects that have not been resolved yet. */
+bool
+resolvePending(Linker * l);
+
+/*
+ * resolvePending, with the objects resolved by nthreads threads (this one
+ * included).  The relocated bytes do not depend on the number of threads.
+ * Branches out of range go through stubs of their own section, else veneers;
+ * unlike with resolvePending, stubs are not shared across objects while
+ * they are resolved.  Objects resolveAll is working on are skipped by other
+ * resolves (they are OBJECT_RESOLVING).  Called with the linker lock held,
+ * it resolves on this thread only.
+ */
+bool
+resolveAll(Linker * l, unsigned nthreads);
+
 /* Prototypes */
 bool
-load_sections(ObjectCode * oc);
+load_sections(Linker * l, ObjectCode * oc);
 
 bool
 get_names(Linker *l, ObjectCode * oc);
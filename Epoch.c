@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include <assert.h>
+#include "Epoch.h"
+
+/*
+ * The global epoch is bumped by every retire.  A reader announces the epoch
+ * it entered in; memory retired in epoch e may still be referenced by readers
+ * that announced e or less, and is released once all active readers
+ * announced something newer.
+ *
+ * A slot holds 0 while its reader is outside of a critical section.  Slots
+ * are padded to a cache line each, such that readers don't share lines.
+ */
+typedef struct _epoch_slot {
+    uint64_t epoch;
+    bool     claimed;
+    char     pad[64 - sizeof(uint64_t) - sizeof(bool)];
+} epoch_slot;
+
+typedef struct _retired {
+    void   * ptr;
+    void  (* release)(void *);
+    uint64_t epoch;
+    struct _retired * next;
+} retired;
+
+static epoch_slot slots[EPOCH_MAX_THREADS] __attribute__((aligned(64)));
+static uint64_t global_epoch = 1;
+
+/* retire and collect are rare; they are serialized by this lock. */
+static pthread_mutex_t retired_lock = PTHREAD_MUTEX_INITIALIZER;
+static retired * retired_list = NULL;
+static size_t    n_retired = 0;
+
+static __thread epoch_slot * my_slot = NULL;
+static __thread unsigned     my_depth = 0;
+
+static pthread_once_t slot_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  slot_key;
+
+static void
+release_slot(void * slot) {
+    __atomic_store_n(&((epoch_slot *)slot)->epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&((epoch_slot *)slot)->claimed, false, __ATOMIC_RELEASE);
+}
+
+static void
+make_slot_key(void) {
+    if(pthread_key_create(&slot_key, release_slot))
+        abort();
+}
+
+static epoch_slot *
+claim_slot(void) {
+    pthread_once(&slot_key_once, make_slot_key);
+    for(unsigned i = 0; i < EPOCH_MAX_THREADS; i++) {
+        bool unclaimed = false;
+        if(__atomic_compare_exchange_n(&slots[i].claimed, &unclaimed, true,
+                                       false, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_RELAXED)) {
+            pthread_setspecific(slot_key, &slots[i]);
+            return &slots[i];
+        }
+    }
+    abort(/* more than EPOCH_MAX_THREADS concurrent readers */);
+}
+
+void
+epoch_enter(void) {
+    if(my_depth++ > 0)
+        return;
+    if(my_slot == NULL)
+        my_slot = claim_slot();
+    /* the announcement must be visible before we load any shared pointer;
+     * this pairs with the fetch_add in epoch_retire. */
+    __atomic_store_n(&my_slot->epoch,
+                     __atomic_load_n(&global_epoch, __ATOMIC_RELAXED),
+                     __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void
+epoch_exit(void) {
+    assert(my_depth > 0);
+    if(--my_depth > 0)
+        return;
+    __atomic_store_n(&my_slot->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* the oldest epoch any reader may still be in */
+static uint64_t
+oldest_active_epoch(void) {
+    uint64_t oldest = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+    for(unsigned i = 0; i < EPOCH_MAX_THREADS; i++) {
+        uint64_t e = __atomic_load_n(&slots[i].epoch, __ATOMIC_SEQ_CST);
+        if(e != 0 && e < oldest)
+            oldest = e;
+    }
+    return oldest;
+}
+
+size_t
+epoch_collect(void) {
+    pthread_mutex_lock(&retired_lock);
+    uint64_t oldest = oldest_active_epoch();
+    retired ** r = &retired_list;
+    while(*r != NULL) {
+        retired * item = *r;
+        /* a reader that announced item->epoch may have seen the pointer */
+        if(item->epoch < oldest) {
+            *r = item->next;
+            item->release(item->ptr);
+            free(item);
+            n_retired--;
+        } else {
+            r = &item->next;
+        }
+    }
+    size_t pending = n_retired;
+    pthread_mutex_unlock(&retired_lock);
+    return pending;
+}
+
+void
+epoch_retire(void * ptr, void (*release)(void *)) {
+    if(ptr == NULL)
+        return;
+    retired * item = malloc(sizeof(retired));
+    assert(item != NULL);
+    item->ptr     = ptr;
+    item->release = release;
+    /* the caller unpublished ptr already; readers entering from here on
+     * announce a newer epoch, and can't find it anymore. */
+    item->epoch   = __atomic_fetch_add(&global_epoch, 1, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_lock(&retired_lock);
+    item->next = retired_list;
+    retired_list = item;
+    n_retired++;
+    pthread_mutex_unlock(&retired_lock);
+
+    epoch_collect();
+}
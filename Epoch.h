@@ -0,0 +1,37 @@
+#ifndef LINK_EPOCH_H
+#define LINK_EPOCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Epoch based reclamation.
+ *
+ * Readers of shared structures (e.g. the global symbol table) bracket their
+ * accesses with epoch_enter/epoch_exit; they never block and never wait.
+ * Writers unpublish memory first, and then hand it to epoch_retire.  Retired
+ * memory is released once every reader that may still hold a reference to it
+ * has left its critical section.
+ *
+ * Each thread claims one of EPOCH_MAX_THREADS reader slots on its first
+ * epoch_enter, and gives it back when it exits.  Critical sections nest; only
+ * the outermost one announces itself.
+ */
+#define EPOCH_MAX_THREADS 256
+
+void
+epoch_enter(void);
+
+void
+epoch_exit(void);
+
+/* release(ptr) once no reader can reference ptr anymore */
+void
+epoch_retire(void * ptr, void (*release)(void *));
+
+/* try to release retired memory now; returns the number still pending */
+size_t
+epoch_collect(void);
+
+#endif //LINK_EPOCH_H
@@ -2,6 +2,12 @@
 #include <string.h>
 #include <stdlib.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 uint32_t jenkins_one_at_a_time_hash(const char* key, size_t length) {
     size_t i = 0;
     uint32_t hash = 0;
@@ -26,7 +32,145 @@ uint64_t knuth_hash(const char* key, size_t length) {
     return hashedValue;
 }
 
-#define KNUTH 1
+/*
+ * Word at a time hashing of NUL terminated strings.
+ *
+ * The string is consumed in 16 byte blocks, read as two little endian 64bit
+ * words.  Each block is mixed into two independent lanes, such that the
+ * multiplications of both lanes can overlap.  The block containing the
+ * terminator has all bytes from the terminator onwards cleared, and is mixed
+ * like any other block; the length is folded in during finalization.
+ *
+ * The terminator is searched for while reading, with SSE2 or NEON if
+ * available, and with the usual has-zero-byte bit trick otherwise.  Blocks
+ * are only loaded whole if they do not cross a page boundary; hence we may
+ * read past the end of the string, but never into an unmapped page.  Close to
+ * a page boundary we fall back to copying the tail byte by byte.  All paths
+ * produce the same hash.
+ */
+#define WW_PAGE_SIZE 4096
+#define WW_K1 0x87c37b91114253d5ull
+#define WW_K2 0x4cf5ad432745937full
+#define WW_ONES  0x0101010101010101ull
+#define WW_HIGHS 0x8080808080808080ull
+
+static inline uint64_t
+rotl64(uint64_t x, unsigned r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+static inline uint64_t
+load64(const char * p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof w);
+    return w;
+}
+
+/* index of the first NUL byte in the 16 byte block at p, or 16 */
+static inline unsigned
+first_nul(const char * p, uint64_t w0, uint64_t w1) {
+#if defined(__SSE2__)
+    (void)w0; (void)w1;
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return m == 0 ? 16 : (unsigned)__builtin_ctz(m);
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    (void)w0; (void)w1;
+    uint8x16_t eq = vceqzq_u8(vld1q_u8((const uint8_t *)p));
+    /* narrow each byte to a nibble; yields a 64bit mask, 4 bits per byte */
+    uint64_t m = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    return m == 0 ? 16 : (unsigned)__builtin_ctzll(m) >> 2;
+#else
+    (void)p;
+    uint64_t z0 = (w0 - WW_ONES) & ~w0 & WW_HIGHS;
+    if(z0) return (unsigned)__builtin_ctzll(z0) >> 3;
+    uint64_t z1 = (w1 - WW_ONES) & ~w1 & WW_HIGHS;
+    if(z1) return 8 + ((unsigned)__builtin_ctzll(z1) >> 3);
+    return 16;
+#endif
+}
+
+static inline void
+mix_block(uint64_t * h1, uint64_t * h2, uint64_t w0, uint64_t w1) {
+    *h1 = rotl64((*h1 ^ w0) * WW_K1, 31) * WW_K2;
+    *h2 = rotl64((*h2 ^ w1) * WW_K2, 33) * WW_K1;
+}
+
+static inline uint64_t
+keep_bytes(uint64_t w, unsigned n) {
+    return n >= 8 ? w : (n == 0 ? 0 : w & ((1ull << (8 * n)) - 1));
+}
+
+uint64_t wordwise_hash(const char* key) {
+    uint64_t h1 = 0x9e3779b97f4a7c15ull;
+    uint64_t h2 = 0x6a09e667f3bcc909ull;
+    const char * p = key;
+
+    while(1) {
+        uint64_t w0, w1;
+        unsigned n;
+        if((((uintptr_t)p) & (WW_PAGE_SIZE - 1)) <= WW_PAGE_SIZE - 16) {
+            w0 = load64(p);
+            w1 = load64(p + 8);
+            n  = first_nul(p, w0, w1);
+        } else {
+            /* the block would cross a page; copy up to the terminator */
+            char block[16] = { 0 };
+            for(n = 0; n < 16 && p[n] != '\0'; n++)
+                block[n] = p[n];
+            w0 = load64(block);
+            w1 = load64(block + 8);
+        }
+        if(n < 16) {
+            w0 = keep_bytes(w0, n);
+            w1 = keep_bytes(w1, n < 8 ? 0 : n - 8);
+        }
+        mix_block(&h1, &h2, w0, w1);
+        if(n < 16) {
+            p += n;
+            break;
+        }
+        p += 16;
+    }
+
+    uint64_t length = (uint64_t)(p - key);
+    return fmix64(h1 ^ rotl64(h2, 27) ^ length);
+}
+
+/*
+ * The same block mixing, over a buffer of known length.  Used to fingerprint
+ * files, not symbol names.
+ */
+uint64_t hash_buffer(const void * data, size_t length) {
+    uint64_t h1 = 0x9e3779b97f4a7c15ull;
+    uint64_t h2 = 0x6a09e667f3bcc909ull;
+    const char * p = data;
+    size_t left = length;
+
+    for(; left >= 16; p += 16, left -= 16)
+        mix_block(&h1, &h2, load64(p), load64(p + 8));
+
+    char block[16] = { 0 };
+    memcpy(block, p, left);
+    mix_block(&h1, &h2, load64(block), load64(block + 8));
+
+    return fmix64(h1 ^ rotl64(h2, 27) ^ (uint64_t)length);
+}
+
+#if !defined(JENKINS) && !defined(KNUTH) && !defined(WORDWISE)
+#define WORDWISE 1
+#endif
 
 hash_t hash(const char * key)
 {
@@ -35,6 +179,9 @@ hash_t hash(const char * key)
 #endif
 #if KNUTH
     return knuth_hash(key, strlen(key));
+#endif
+#if WORDWISE
+    return wordwise_hash(key);
 #endif
     abort(/* no hash function defined */);
 }
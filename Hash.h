@@ -2,9 +2,21 @@
 #define Hash_h
 
 #include <stdio.h>
+#include <stdint.h>
 
 typedef uint64_t hash_t;
 
+/*
+ * The symbol name hash.  Defaults to the word at a time hash; define JENKINS
+ * or KNUTH to select one of the byte at a time hashes instead.
+ */
 hash_t hash(const char * str);
 
+uint32_t jenkins_one_at_a_time_hash(const char* key, size_t length);
+uint64_t knuth_hash(const char* key, size_t length);
+uint64_t wordwise_hash(const char* key);
+
+/* hash arbitrary bytes, e.g. file contents */
+uint64_t hash_buffer(const void * data, size_t length);
+
 #endif /* Hash_h */
@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "Index.h"
+#include "Linker.h"
+#include "Elf.h"
+#include "debug.h"
+
+/* hashed into the header; a different name hash function yields a different
+ * fingerprint, and invalidates the index. */
+#define INDEX_FINGERPRINT_KEY "liblink symbol index"
+
+/*
+ * Writing
+ */
+typedef struct _index_builder {
+    index_input  * inputs;
+    size_t n_inputs;
+    index_member * members;
+    size_t n_members;
+    index_entry  * entries;
+    size_t n_entries;
+    char * strings;
+    size_t strings_size;
+    size_t strings_capacity;
+} index_builder;
+
+static void *
+grow(void * array, size_t n, size_t size) {
+    /* grow by doubling, whenever n hits a power of two */
+    if(n == 0 || (n & (n - 1)) == 0) {
+        array = realloc(array, (n == 0 ? 1 : 2 * n) * size);
+        assert(array != NULL);
+    }
+    return array;
+}
+
+static uint64_t
+add_string(index_builder * b, const char * s) {
+    size_t len = strlen(s) + 1;
+    if(b->strings_size + len > b->strings_capacity) {
+        while(b->strings_size + len > b->strings_capacity)
+            b->strings_capacity = b->strings_capacity == 0
+                                  ? 4096 : 2 * b->strings_capacity;
+        b->strings = realloc(b->strings, b->strings_capacity);
+        assert(b->strings != NULL);
+    }
+    memcpy(b->strings + b->strings_size, s, len);
+    uint64_t offset = b->strings_size;
+    b->strings_size += len;
+    return offset;
+}
+
+static bool
+hash_file(const char * path, uint64_t * size, int64_t * mtime,
+          uint64_t * content_hash) {
+    struct stat st;
+    if(stat(path, &st))
+        return EXIT_FAILURE;
+    *size  = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    if(content_hash == NULL)
+        return EXIT_SUCCESS;
+    if(st.st_size == 0) {
+        *content_hash = hash_buffer("", 0);
+        return EXIT_SUCCESS;
+    }
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return EXIT_FAILURE;
+    void * data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return EXIT_FAILURE;
+    *content_hash = hash_buffer(data, (size_t)st.st_size);
+    munmap(data, (size_t)st.st_size);
+    return EXIT_SUCCESS;
+}
+
+static bool
+add_input(index_builder * b, const char * path, uint32_t * input) {
+    for(size_t i = 0; i < b->n_inputs; i++) {
+        if(0 == strcmp(b->strings + b->inputs[i].path, path)) {
+            *input = (uint32_t)i;
+            return EXIT_SUCCESS;
+        }
+    }
+    index_input in = { 0 };
+    if(hash_file(path, &in.size, &in.mtime, &in.content_hash)) {
+        link_log(LINK_LOG_WARN, LINK_LOG_INDEX,
+                 "Failed to fingerprint %s\n", path);
+        return EXIT_FAILURE;
+    }
+    in.path = add_string(b, path);
+    b->inputs = grow(b->inputs, b->n_inputs, sizeof(index_input));
+    *input = (uint32_t)b->n_inputs;
+    b->inputs[b->n_inputs++] = in;
+    return EXIT_SUCCESS;
+}
+
+static int
+compare_entries(const void * a, const void * b) {
+    const index_entry * x = a, * y = b;
+    return x->hash < y->hash ? -1 : (x->hash > y->hash ? 1 : 0);
+}
+
+static bool
+write_all(FILE * f, const void * data, size_t size) {
+    return size == 0 || fwrite(data, size, 1, f) == 1;
+}
+
+bool
+writeSymbolIndex(Linker * l, const char * path) {
+    index_builder b = { 0 };
+    add_string(&b, ""); /* offset 0 is the empty string */
+    bool failed = false;
+
+    for(ObjectCode * oc = l->objects; oc != NULL && !failed; oc = oc->next) {
+        /* there is no file to load it from again */
+        if(oc->imageFromMemory)
+            continue;
+        uint32_t input = 0;
+        if(add_input(&b, oc->fileName, &input)) {
+            failed = true;
+            break;
+        }
+        index_member m = {
+                .input  = input,
+                .name   = oc->archiveMemberName == NULL
+                          ? 0 : add_string(&b, oc->archiveMemberName),
+                .offset = oc->archiveMemberName == NULL
+                          ? 0 : (uint64_t)oc->archiveMemberOffset,
+                .size   = (uint64_t)oc->fileSize
+        };
+        uint32_t member = (uint32_t)b.n_members;
+        b.members = grow(b.members, b.n_members, sizeof(index_member));
+        b.members[b.n_members++] = m;
+
+        /* oc->symbols holds the names this object put into gsyms */
+        for(unsigned i = 0; i < oc->n_symbols && oc->symbols[i] != NULL; i++) {
+            const char * name = oc->symbols[i];
+            GlobalSymbol * g = NULL;
+            if(symbol_table_lookup(&l->gsyms, hash(name), name, (void**)&g)
+               || g->oc != oc || g->symbol->elf_sym == NULL)
+                continue;
+            ElfSym * sym = g->symbol->elf_sym;
+            index_entry e = {
+                    .hash    = symbol_hash(l, g->symbol),
+                    .name    = add_string(&b, name),
+                    .member  = member,
+                    .section = sym->st_shndx,
+                    .binding = (uint8_t)ELF_ST_BIND(sym->st_info),
+                    .value   = (uint64_t)sym->st_value
+            };
+            b.entries = grow(b.entries, b.n_entries, sizeof(index_entry));
+            b.entries[b.n_entries++] = e;
+        }
+    }
+
+    if(!failed) {
+        qsort(b.entries, b.n_entries, sizeof(index_entry), compare_entries);
+
+        index_header h = { .version = SYMBOL_INDEX_VERSION };
+        memcpy(h.magic, SYMBOL_INDEX_MAGIC, sizeof h.magic);
+        h.addr_size        = sizeof(addr_t);
+        h.hash_fingerprint = hash(INDEX_FINGERPRINT_KEY);
+        h.n_inputs         = (uint32_t)b.n_inputs;
+        h.n_members        = (uint32_t)b.n_members;
+        h.n_entries        = (uint32_t)b.n_entries;
+        h.inputs_offset    = sizeof(index_header);
+        h.members_offset   = h.inputs_offset  + b.n_inputs  * sizeof(index_input);
+        h.entries_offset   = h.members_offset + b.n_members * sizeof(index_member);
+        h.strings_offset   = h.entries_offset + b.n_entries * sizeof(index_entry);
+        h.strings_size     = b.strings_size;
+
+        /* write to a temporary file, and rename it into place; a concurrent
+         * reader sees either the old or the new index, never half of one. */
+        char tmp[512];
+        snprintf(tmp, sizeof tmp, "%s.%d.tmp", path, (int)getpid());
+        FILE * f = fopen(tmp, "wb");
+        if(f == NULL) {
+            link_log(LINK_LOG_WARN, LINK_LOG_INDEX,
+                     "Failed to open %s for writing\n", tmp);
+            failed = true;
+        } else {
+            failed = !write_all(f, &h, sizeof h)
+                  || !write_all(f, b.inputs,  b.n_inputs  * sizeof(index_input))
+                  || !write_all(f, b.members, b.n_members * sizeof(index_member))
+                  || !write_all(f, b.entries, b.n_entries * sizeof(index_entry))
+                  || !write_all(f, b.strings, b.strings_size);
+            failed = (0 != fclose(f)) || failed;
+            if(failed || 0 != rename(tmp, path)) {
+                link_log(LINK_LOG_WARN, LINK_LOG_INDEX,
+                         "Failed to write symbol index %s\n", path);
+                unlink(tmp);
+                failed = true;
+            }
+        }
+    }
+    if(!failed)
+        link_log(LINK_LOG_INFO, LINK_LOG_INDEX,
+                 "Wrote symbol index %s: %lu inputs, %lu members, "
+                 "%lu symbols\n", path, (unsigned long)b.n_inputs,
+                 (unsigned long)b.n_members, (unsigned long)b.n_entries);
+
+    free(b.inputs);
+    free(b.members);
+    free(b.entries);
+    free(b.strings);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ * Reading
+ */
+static bool
+in_bounds(SymbolIndex * idx, uint64_t offset, uint64_t count, size_t size) {
+    return offset <= idx->map_size
+        && count <= (idx->map_size - offset) / size;
+}
+
+static bool
+valid_string(SymbolIndex * idx, uint64_t offset) {
+    return offset < idx->header->strings_size;
+}
+
+static bool
+validate_layout(SymbolIndex * idx) {
+    index_header * h = idx->header;
+    if(0 != memcmp(h->magic, SYMBOL_INDEX_MAGIC, sizeof h->magic)
+       || h->version != SYMBOL_INDEX_VERSION
+       || h->addr_size != sizeof(addr_t)) {
+        link_log(LINK_LOG_INFO, LINK_LOG_INDEX,
+                 "Symbol index: incompatible format\n");
+        return false;
+    }
+    if(h->hash_fingerprint != hash(INDEX_FINGERPRINT_KEY)) {
+        link_log(LINK_LOG_INFO, LINK_LOG_INDEX,
+                 "Symbol index: written with a different hash function\n");
+        return false;
+    }
+    if(!in_bounds(idx, h->inputs_offset,  h->n_inputs,  sizeof(index_input))
+       || !in_bounds(idx, h->members_offset, h->n_members, sizeof(index_member))
+       || !in_bounds(idx, h->entries_offset, h->n_entries, sizeof(index_entry))
+       || !in_bounds(idx, h->strings_offset, h->strings_size, 1)
+       || h->strings_size == 0
+       || idx->map[h->strings_offset + h->strings_size - 1] != '\0') {
+        link_log(LINK_LOG_WARN, LINK_LOG_INDEX,
+                 "Symbol index: truncated or corrupt\n");
+        return false;
+    }
+    return true;
+}
+
+static bool
+validate_references(SymbolIndex * idx) {
+    index_header * h = idx->header;
+    for(uint32_t i = 0; i < h->n_inputs; i++)
+        if(!valid_string(idx, idx->inputs[i].path))
+            return false;
+    for(uint32_t i = 0; i < h->n_members; i++)
+        if(idx->members[i].input >= h->n_inputs
+           || !valid_string(idx, idx->members[i].name))
+            return false;
+    for(uint32_t i = 0; i < h->n_entries; i++)
+        if(idx->entries[i].member >= h->n_members
+           || !valid_string(idx, idx->entries[i].name)
+           || (i > 0 && idx->entries[i - 1].hash > idx->entries[i].hash))
+            return false;
+    return true;
+}
+
+static bool
+inputs_unchanged(SymbolIndex * idx, bool validate_content) {
+    for(uint32_t i = 0; i < idx->header->n_inputs; i++) {
+        index_input * in = &idx->inputs[i];
+        const char * path = idx->strings + in->path;
+        uint64_t size = 0, content_hash = 0;
+        int64_t mtime = 0;
+        if(hash_file(path, &size, &mtime,
+                     validate_content ? &content_hash : NULL)) {
+            link_log(LINK_LOG_INFO, LINK_LOG_INDEX,
+                     "Symbol index: input %s is gone\n", path);
+            return false;
+        }
+        if(size != in->size || mtime != in->mtime
+           || (validate_content && content_hash != in->content_hash)) {
+            link_log(LINK_LOG_INFO, LINK_LOG_INDEX,
+                     "Symbol index: input %s has changed\n", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+SymbolIndex *
+loadSymbolIndex(const char * path, bool validate_content) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    struct stat st;
+    if(fstat(fd, &st) || (size_t)st.st_size < sizeof(index_header)) {
+        close(fd);
+        return NULL;
+    }
+    void * map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return NULL;
+
+    SymbolIndex * idx = calloc(1, sizeof(SymbolIndex));
+    assert(idx != NULL);
+    idx->map      = map;
+    idx->map_size = (size_t)st.st_size;
+    idx->header   = map;
+
+    if(!validate_layout(idx)) {
+        freeSymbolIndex(idx);
+        return NULL;
+    }
+    idx->inputs  = (index_input  *)(idx->map + idx->header->inputs_offset);
+    idx->members = (index_member *)(idx->map + idx->header->members_offset);
+    idx->entries = (index_entry  *)(idx->map + idx->header->entries_offset);
+    idx->strings = (char *)(idx->map + idx->header->strings_offset);
+
+    if(!validate_references(idx)) {
+        link_log(LINK_LOG_WARN, LINK_LOG_INDEX, "Symbol index: corrupt\n");
+        freeSymbolIndex(idx);
+        return NULL;
+    }
+    if(!inputs_unchanged(idx, validate_content)) {
+        freeSymbolIndex(idx);
+        return NULL;
+    }
+
+    idx->loaded = calloc(idx->header->n_members + 1, sizeof(bool));
+    assert(idx->loaded != NULL);
+    link_log(LINK_LOG_INFO, LINK_LOG_INDEX,
+             "Mapped symbol index %s: %u inputs, %u members, %u symbols\n",
+             path, idx->header->n_inputs, idx->header->n_members,
+             idx->header->n_entries);
+    return idx;
+}
+
+void
+freeSymbolIndex(SymbolIndex * idx) {
+    if(idx == NULL)
+        return;
+    if(idx->map != NULL)
+        munmap(idx->map, idx->map_size);
+    free(idx->loaded);
+    free(idx);
+}
+
+static bool
+same_member(SymbolIndex * idx, index_member * m, ObjectCode * oc) {
+    if(0 != strcmp(idx->strings + idx->inputs[m->input].path, oc->fileName))
+        return false;
+    if(m->name == 0)
+        return oc->archiveMemberName == NULL;
+    return oc->archiveMemberName != NULL
+        && (uint64_t)oc->archiveMemberOffset == m->offset;
+}
+
+void
+attachSymbolIndex(Linker * l, SymbolIndex * idx) {
+    /* members that are loaded already must not be loaded a second time */
+    for(uint32_t i = 0; i < idx->header->n_members; i++)
+        for(ObjectCode * oc = l->objects; oc != NULL; oc = oc->next)
+            if(same_member(idx, &idx->members[i], oc))
+                idx->loaded[i] = true;
+    l->index = idx;
+}
+
+index_entry *
+symbol_index_lookup(SymbolIndex * idx, hash_t h, const char * name) {
+    /* lower bound of h */
+    size_t lo = 0, hi = idx->header->n_entries;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(idx->entries[mid].hash < (uint64_t)h) lo = mid + 1;
+        else hi = mid;
+    }
+    for(; lo < idx->header->n_entries && idx->entries[lo].hash == (uint64_t)h;
+        lo++)
+        if(0 == strcmp(idx->strings + idx->entries[lo].name, name))
+            return &idx->entries[lo];
+    return NULL;
+}
+
+bool
+symbol_index_load_member(Linker * l, SymbolIndex * idx, index_entry * entry) {
+    if(idx->loaded[entry->member])
+        return EXIT_SUCCESS;
+    /* whatever happens, don't try again */
+    idx->loaded[entry->member] = true;
+    /* read without the linker lock; see lookupSymbol_ */
+    __atomic_fetch_add(&idx->n_loaded, 1, __ATOMIC_RELAXED);
+
+    index_member * m = &idx->members[entry->member];
+    char * path = idx->strings + idx->inputs[m->input].path;
+
+    if(m->name == 0) {
+        loadObject(l, NULL, path);
+        return EXIT_SUCCESS;
+    }
+
+    FILE * ar = fopen(path, "rb");
+    if(ar == NULL) {
+        link_log(LINK_LOG_WARN, LINK_LOG_INDEX, "Failed to open %s\n", path);
+        return EXIT_FAILURE;
+    }
+    uint8_t * image = read_archive_member(ar, (long)m->offset,
+                                          (unsigned)m->size);
+    fclose(ar);
+    if(image == NULL) {
+        link_log(LINK_LOG_WARN, LINK_LOG_INDEX,
+                 "Failed to read %s(%s)\n", path, idx->strings + m->name);
+        return EXIT_FAILURE;
+    }
+    ObjectCode * oc = mkOc(path, image, (long)m->size, false,
+                           idx->strings + m->name, 0);
+    oc->archiveMemberOffset = (long)m->offset;
+    processObject(l, oc);
+    return EXIT_SUCCESS;
+}
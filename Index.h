@@ -0,0 +1,124 @@
+#ifndef LINK_INDEX_H
+#define LINK_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Hash.h"
+
+/*
+ * Persistent global symbol index.
+ *
+ * The index records, for every global symbol of a linker session, which
+ * input file (and archive member) defines it.  It is written once after a
+ * (cold) session has loaded its inputs, and mapped on subsequent (warm)
+ * starts.  A warm session does not load any archives up front; members are
+ * loaded (and resolved) on demand, when a lookup misses the global symbol
+ * table but hits the index.
+ *
+ * The file is laid out to be used straight from an mmap:
+ *
+ * .-----------------.
+ * | header          |
+ * |-----------------|
+ * | inputs[]        |  path, size, mtime, content hash
+ * |-----------------|
+ * | members[]       |  input, offset and size of the member
+ * |-----------------|
+ * | entries[]       |  sorted by hash
+ * |-----------------|
+ * | strings         |
+ * '-----------------'
+ *
+ * An index is only used if it was written by the same index version and
+ * name hash function, and if all its inputs are unchanged.
+ */
+#define SYMBOL_INDEX_MAGIC   "LLINKIDX"
+#define SYMBOL_INDEX_VERSION 1
+
+typedef struct _index_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t addr_size;        /* sizeof(addr_t) of the writer */
+    uint64_t hash_fingerprint; /* hash() of a fixed string */
+    uint32_t n_inputs;
+    uint32_t n_members;
+    uint32_t n_entries;
+    uint32_t reserved;
+    uint64_t inputs_offset;
+    uint64_t members_offset;
+    uint64_t entries_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+} index_header;
+
+typedef struct _index_input {
+    uint64_t path;             /* string offset */
+    uint64_t size;
+    int64_t  mtime;
+    uint64_t content_hash;     /* hash_buffer over the whole file */
+} index_input;
+
+typedef struct _index_member {
+    uint32_t input;
+    uint32_t reserved;
+    uint64_t name;             /* string offset; 0 if not an archive member */
+    uint64_t offset;           /* of the member's contents in the input */
+    uint64_t size;
+} index_member;
+
+typedef struct _index_entry {
+    uint64_t hash;
+    uint64_t name;             /* string offset */
+    uint32_t member;
+    uint16_t section;          /* st_shndx */
+    uint8_t  binding;          /* STB_* */
+    uint8_t  reserved;
+    uint64_t value;            /* st_value, i.e. offset into the section */
+} index_entry;
+
+typedef struct _SymbolIndex {
+    uint8_t      * map;
+    size_t         map_size;
+    index_header * header;
+    index_input  * inputs;
+    index_member * members;
+    index_entry  * entries;
+    char         * strings;
+
+    /* members loaded into the session so far, and how many of them were
+     * loaded on demand */
+    bool         * loaded;
+    size_t         n_loaded;
+} SymbolIndex;
+
+/* forward declaration; see Linker.h */
+struct _linker;
+
+/* Write the index of all global symbols in the session to path. */
+bool
+writeSymbolIndex(struct _linker * l, const char * path);
+
+/*
+ * Map the index at path.  Returns NULL if there is none, or if it is stale.
+ * With validate_content, the inputs' contents are hashed and compared as
+ * well; otherwise only their size and mtime.
+ */
+SymbolIndex *
+loadSymbolIndex(const char * path, bool validate_content);
+
+void
+freeSymbolIndex(SymbolIndex * idx);
+
+/* Use the index to load archive members on demand. */
+void
+attachSymbolIndex(struct _linker * l, SymbolIndex * idx);
+
+index_entry *
+symbol_index_lookup(SymbolIndex * idx, hash_t h, const char * name);
+
+/* Load the member defining the entry, unless it is loaded already. */
+bool
+symbol_index_load_member(struct _linker * l, SymbolIndex * idx,
+                         index_entry * entry);
+
+#endif //LINK_INDEX_H
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "Intern.h"
+
+#define STRING_ARENA_CHUNK_SIZE (64 * 1024)
+
+static char *
+arena_alloc(interned_names * names, size_t size) {
+    string_arena_chunk * c = names->chunks;
+    if(c == NULL || c->size - c->used < size) {
+        size_t chunk_size = size > STRING_ARENA_CHUNK_SIZE
+                            ? size : STRING_ARENA_CHUNK_SIZE;
+        c = malloc(sizeof(string_arena_chunk) + chunk_size);
+        assert(c != NULL);
+        c->used = 0;
+        c->size = chunk_size;
+        c->next = names->chunks;
+        names->chunks = c;
+    }
+    char * p = c->data + c->used;
+    c->used += size;
+    return p;
+}
+
+const char *
+find_interned(interned_names * names, const char * name, hash_t h) {
+    const char * interned = NULL;
+    if(symbol_table_lookup_key(&names->set, h, name, &interned))
+        return NULL;
+    return interned;
+}
+
+const char *
+intern_name(interned_names * names, const char * name, hash_t h) {
+    names->requests++;
+
+    const char * interned = find_interned(names, name, h);
+    if(interned != NULL)
+        return interned;
+
+    size_t len = strlen(name) + 1;
+    char * copy = arena_alloc(names, len);
+    memcpy(copy, name, len);
+    names->bytes += len;
+
+    if(symbol_table_insert(&names->set, h, copy, NULL))
+        abort(/* can't fail, we just missed it */);
+    return copy;
+}
+
+void
+interned_names_free(interned_names * names) {
+    symbol_table_free(&names->set);
+    while(names->chunks != NULL) {
+        string_arena_chunk * c = names->chunks;
+        names->chunks = c->next;
+        free(c);
+    }
+    names->bytes = 0;
+    names->requests = 0;
+}
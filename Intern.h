@@ -0,0 +1,47 @@
+#ifndef Intern_h
+#define Intern_h
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "Hash.h"
+#include "SymbolTable.h"
+
+/*
+ * Linker wide symbol name interning.
+ *
+ * Each distinct name is copied once into a chunked arena, and deduplicated by
+ * its hash (and contents).  Interned names can be compared by pointer.
+ *
+ * Only the names that take part in resolution are interned (see
+ * intern_symbol_names); what that buys is pointer compares when the global
+ * symbol table and fill_got match names, and keys for the global symbol
+ * table that need not outlive the embedder's call (insert_global_symbol).
+ * Once an object's names are interned its image is released, and a name
+ * shared by several objects is kept once (see release_image).
+ */
+typedef struct _string_arena_chunk {
+    struct _string_arena_chunk * next;
+    size_t used;
+    size_t size;
+    char   data[];
+} string_arena_chunk;
+
+typedef struct _interned_names {
+    symbol_table         set;     /* name -> NULL; keys are the interned names */
+    string_arena_chunk * chunks;  /* most recent first */
+    size_t bytes;                 /* bytes copied into the arena */
+    size_t requests;              /* number of calls to intern_name */
+} interned_names;
+
+/* the interned copy of name; h must be hash(name) */
+const char *
+intern_name(interned_names * names, const char * name, hash_t h);
+
+/* the interned copy of name, or NULL if name was never interned */
+const char *
+find_interned(interned_names * names, const char * name, hash_t h);
+
+void
+interned_names_free(interned_names * names);
+
+#endif /* Intern_h */
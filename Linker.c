@@ -2,20 +2,64 @@
 #include <stdlib.h>
 #include <dlfcn.h>
 #include <assert.h>
+#include <string.h>
 
 #include "Linker.h"
 #include "Elf.h"
+#include "Epoch.h"
 #include "debug.h"
 
-Linker LINKER = { .symbols = NULL, .gsyms = NULL, .objects = NULL };
+Linker LINKER = { .symbols = NULL, .names = { .set = { 0 } }, .gsyms = { 0 },
+                  .syscache = { 0 },
+                  .dynobjs = { 0 }, .objects = NULL, .index = NULL,
+                  .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* counters bumped by (lock free) readers */
+#define COUNT_READ(l, counter) \
+    __atomic_fetch_add(&(l)->stats.counter, 1, __ATOMIC_RELAXED)
+
+/*
+ * lock_owner is read by every thread, and written under the mutex; it is
+ * cleared before the mutex is released, such that a thread can only ever
+ * see its own id there while it holds the lock.  lock_depth is the owner's.
+ */
+void
+linker_lock(Linker * l) {
+    pthread_t self = pthread_self();
+    if(pthread_equal(__atomic_load_n(&l->lock_owner, __ATOMIC_RELAXED),
+                     self)) {
+        l->lock_depth++;
+        return;
+    }
+    pthread_mutex_lock(&l->lock);
+    __atomic_store_n(&l->lock_owner, self, __ATOMIC_RELAXED);
+    l->lock_depth = 1;
+}
+
+void
+linker_unlock(Linker * l) {
+    assert(l->lock_depth > 0);
+    if(--l->lock_depth == 0) {
+        __atomic_store_n(&l->lock_owner, (pthread_t)0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&l->lock);
+    }
+}
+
+static size_t
+indexed_members_loaded(Linker * l) {
+    return l->index == NULL
+           ? 0 : __atomic_load_n(&l->index->n_loaded, __ATOMIC_RELAXED);
+}
 
 bool
 insert_global_symbol(Linker * l, GlobalSymbol * symbol)
 {
+    linker_lock(l);
     if(symbol->is_weak) {
         /* let's see if we can resolve that symbol to a known system symbol */
         assert(0x0 != symbol->symbol->addr);
-        if(lookup_system_symbols(symbol->symbol->name,
+        if(lookup_system_symbols(l, symbol->symbol->name,
+                                 symbol_hash(l, symbol->symbol),
                                  &symbol->symbol->addr)) {
             /* failed to find it in the global symbols */
             assert(0x0 != symbol->symbol->addr);
@@ -26,69 +70,417 @@ insert_global_symbol(Linker * l, GlobalSymbol * symbol)
         }
     }
     assert(!symbol->is_weak);
-    binary_tree_insert(&l->gsyms, symbol->symbol->hash, symbol);
+    /* names from object code are interned already; those from the embedder
+     * might not be. */
+    hash_t h = symbol_hash(l, symbol->symbol);
+    symbol->symbol->name = (SymbolName *)intern_name(&l->names,
+                                                     symbol->symbol->name, h);
+    bool inserted = !symbol_table_insert(&l->gsyms, h, symbol->symbol->name,
+                                         symbol);
+    linker_unlock(l);
+    if(!inserted)
+        link_log(LINK_LOG_ERROR, LINK_LOG_SYMBOL,
+                 "Duplicate global symbol %s\n", symbol->symbol->name);
+    return inserted;
+}
+
+/*
+ * The hash of a symbol's name.  ocInit only hashes the names of symbols that
+ * may end up in (or be looked up in) the global symbol table; all others are
+ * hashed here, on demand.
+ */
+hash_t
+symbol_hash(Linker * l, ElfSymbol * symbol) {
+    if(!symbol->hash_valid) {
+        symbol->hash = hash(symbol->name);
+        symbol->hash_valid = true;
+        COUNT_READ(l, hashes_deferred_computed); /* see resolveAll */
+    }
+    return symbol->hash;
+}
+
+/*
+ * System symbols are resolved through dlsym, and memoized in the linker's
+ * system symbol cache.  The cache holds negative results as well (as a NULL
+ * value), hence it has to be flushed when new libraries are loaded; see
+ * linkerDlopen.
+ *
+ * Cache hits are lock free; misses are filled under the linker lock.
+ */
+static bool
+cached_system_symbol(Linker * l, const char * name, hash_t h, addr_t * addr,
+                     bool * result) {
+    void * cached = NULL;
+    if(symbol_table_lookup(&l->syscache, h, name, &cached))
+        return false;
+    if(NULL == cached) {
+        COUNT_READ(l, syscache_negative_hits);
+        *addr = 0x0;
+        *result = EXIT_FAILURE;
+    } else {
+        COUNT_READ(l, syscache_hits);
+        *addr = (addr_t)cached;
+        *result = EXIT_SUCCESS;
+    }
     return true;
 }
 
 bool
-lookup_system_symbols(const char * name, addr_t * addr)
+lookup_system_symbols(Linker * l, const char * name, hash_t h, addr_t * addr)
 {
-    *addr = (addr_t)dlsym(RTLD_DEFAULT /*libHandle*/, name);
+    bool result;
+    if(cached_system_symbol(l, name, h, addr, &result))
+        return result;
+
+    linker_lock(l);
+    /* another thread may have filled it in the meantime */
+    if(cached_system_symbol(l, name, h, addr, &result)) {
+        linker_unlock(l);
+        return result;
+    }
+    l->stats.syscache_misses++;
+
+    /* try the registered libraries first; this avoids dlsym's locking and
+     * error reporting.  Only a symbol they define ahead of every other
+     * loaded object is found there (see dynsym.h); the rest is left to
+     * dlsym. */
+    if(DYNSYM_FOUND == dynamic_objects_lookup(&l->dynobjs, name, addr))
+        l->stats.dynsym_hits++;
+    else
+        *addr = (addr_t)dlsym(RTLD_DEFAULT /*libHandle*/, name);
+
+    char * key = strdup(name);
+    assert(key != NULL);
+    if(symbol_table_insert(&l->syscache, h, key, (void*)*addr))
+        abort(/* can't fail, we just missed it */);
+    linker_unlock(l);
+
     if(0x0 == *addr) {
         const char * err = dlerror();
-        __link_log("Failed to lookup symbol %s; error: %s\n", name, err);
+        link_log(LINK_LOG_DEBUG, LINK_LOG_SYMBOL,
+                 "Failed to lookup symbol %s; error: %s\n", name, err);
         return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
 }
 
+static void
+flush_system_symbol(symbol_table_entry * e, void * ctx) {
+    /* with a cache given, only the negative entries are deleted from it;
+     * otherwise all keys are released, and the table is freed after.  Keys
+     * are retired, concurrent readers may still be comparing them. */
+    symbol_table * cache = ctx;
+    if(cache != NULL && e->value != NULL)
+        return; /* keep positive entries */
+    char * key = (char *)e->name;
+    if(cache != NULL)
+        symbol_table_delete(cache, e->hash, key, NULL);
+    epoch_retire(key, free);
+}
+
+void
+flushSystemSymbolCache(Linker * l, bool negative_only) {
+    linker_lock(l);
+    if(negative_only) {
+        symbol_table_walk(&l->syscache, flush_system_symbol, &l->syscache);
+    } else {
+        symbol_table_walk(&l->syscache, flush_system_symbol, NULL);
+        symbol_table_free(&l->syscache);
+    }
+    /* the keys were retired inside the walk */
+    epoch_collect();
+    linker_unlock(l);
+}
+
+void *
+linkerDlopen(Linker * l, const char * path, int flags) {
+    void * handle = dlopen(path, flags);
+    /* a new library can only add symbols to the global scope; positive
+     * results remain valid. */
+    if(handle != NULL) {
+        linker_lock(l);
+        flushSystemSymbolCache(l, true);
+        /* the loaded objects changed; see dynamic_objects_lookup */
+        l->dynobjs.stale = true;
+        if(flags & RTLD_GLOBAL)
+            dynamic_objects_register(&l->dynobjs, path);
+        linker_unlock(l);
+    }
+    return handle;
+}
+
+bool
+linkerIndexLibrary(Linker * l, const char * name) {
+    linker_lock(l);
+    bool r = dynamic_objects_register(&l->dynobjs, name);
+    linker_unlock(l);
+    return r;
+}
+
+/* the global symbols of loaded objects; the embedder's have no object */
+static void
+free_global_symbol(symbol_table_entry * e, void * ctx __attribute__((unused))) {
+    GlobalSymbol * g = e->value;
+    if(g != NULL && g->oc != NULL)
+        free(g);
+}
+
+void
+linkerFree(Linker * l) {
+    linker_lock(l);
+    symbol_table_walk(&l->gsyms, free_global_symbol, NULL);
+    symbol_table_free(&l->gsyms);
+    for(ObjectCode * oc = l->objects; oc != NULL; ) {
+        ObjectCode * next = oc->next;
+        freeObjectCode(l, oc);
+        oc = next;
+    }
+    l->objects = NULL;
+    addr_index_free(&l->ranges);
+    free_veneers(&l->veneers);
+    code_arena_free(&l->code);
+    dynamic_objects_free(&l->dynobjs);
+    flushSystemSymbolCache(l, false);
+    interned_names_free(&l->names);
+    linker_unlock(l);
+
+    /* the tables' slots, retired above */
+    epoch_collect();
+    pthread_mutex_destroy(&l->lock);
+    memset(l, 0, sizeof(Linker));
+}
+
 bool
-lookup_global_symbol(binary_tree_node * gsyms, ElfSymbol * needle, addr_t *addr)
+lookup_global_symbol(symbol_table * gsyms, ElfSymbol * needle, addr_t *addr)
 {
     GlobalSymbol * s = NULL;
-    if(binary_tree_lookup(gsyms, needle->hash, (void**)&s))
+    if(symbol_table_lookup(gsyms, needle->hash, needle->name, (void**)&s))
         return EXIT_FAILURE;
     *addr = s->symbol->addr;
     return EXIT_SUCCESS;
 }
 
 bool
-lookup_global_symbol_(binary_tree_node * gsyms, char * name, addr_t * addr)
+lookup_global_symbol_(symbol_table * gsyms, char * name, addr_t * addr)
 {
-    ElfSymbol needle = { .name = name, .hash = hash(name) };
+    ElfSymbol needle = { .name = name, .hash = hash(name), .hash_valid = true };
     return lookup_global_symbol(gsyms, &needle, addr);
 }
 
+/*
+ * With a symbol index attached, global symbols we haven't seen yet may be
+ * defined by an archive member that has not been loaded yet.  Load it, and
+ * look again.  The member is loaded, but not resolved; see lookupSymbol_.
+ */
+static bool
+load_indexed_symbol(Linker * l, const char * name, hash_t h) {
+    if(l->index == NULL)
+        return EXIT_FAILURE;
+    index_entry * e = symbol_index_lookup(l->index, h, name);
+    if(e == NULL)
+        return EXIT_FAILURE;
+    linker_lock(l);
+    bool r = symbol_index_load_member(l, l->index, e);
+    linker_unlock(l);
+    return r;
+}
+
 addr_t
-lookupSymbol_(Linker * l, char * name) {
+lookup_symbol(Linker * l, const char * name, hash_t h) {
     addr_t addr = 0x0;
+    ElfSymbol needle = { .name = (char *)name, .hash = h, .hash_valid = true };
 
-    if(lookup_global_symbol_(l->gsyms, name, &addr)
-       && lookup_system_symbols(name, &addr)) {
-        __link_log(
+    if(lookup_global_symbol(&l->gsyms, &needle, &addr)
+       && (load_indexed_symbol(l, name, h)
+           || lookup_global_symbol(&l->gsyms, &needle, &addr))
+       && lookup_system_symbols(l, name, h, &addr)) {
+        link_log(LINK_LOG_WARN, LINK_LOG_SYMBOL,
                 "WARN: failed to find symbol '%s' ins global or system symbols!\n",
                 name);
     }
     return addr;
 }
 
+addr_t
+lookupSymbol_(Linker * l, char * name) {
+    size_t loaded = indexed_members_loaded(l);
+    addr_t addr = lookup_symbol(l, name, hash(name));
+    /* objects loaded on demand have to be resolved before use */
+    if(indexed_members_loaded(l) != loaded && resolvePending(l))
+        return 0x0;
+    return addr;
+}
+
+bool
+lookupSymbolHandle_(Linker * l, const char * name, SymbolHandle * handle) {
+    handle->hash   = hash(name);
+    handle->symbol = NULL;
+    handle->addr   = 0x0;
+    /* the handle may outlive the caller's name; symbolHandleAddr looks it
+     * up again, if it is not found now */
+    linker_lock(l);
+    handle->name   = intern_name(&l->names, name, handle->hash);
+    linker_unlock(l);
+    name = handle->name;
+
+    GlobalSymbol * s = NULL;
+    if(!symbol_table_lookup(&l->gsyms, handle->hash, name, (void**)&s)
+       || (!load_indexed_symbol(l, name, handle->hash)
+           && !resolvePending(l)
+           && !symbol_table_lookup(&l->gsyms, handle->hash, name,
+                                   (void**)&s))) {
+        handle->symbol = s;
+        handle->addr   = s->symbol->addr;
+        return EXIT_SUCCESS;
+    }
+    return lookup_system_symbols(l, name, handle->hash, &handle->addr);
+}
+
+addr_t
+symbolHandleAddr(Linker * l, SymbolHandle * handle) {
+    if(handle->symbol != NULL)
+        return handle->symbol->symbol->addr;
+    if(handle->addr == 0x0) {
+        /* not found at the time; it may have been loaded since. */
+        GlobalSymbol * s = NULL;
+        if(!symbol_table_lookup(&l->gsyms, handle->hash, handle->name,
+                                (void**)&s)) {
+            handle->symbol = s;
+            return s->symbol->addr;
+        }
+        lookup_system_symbols(l, handle->name, handle->hash, &handle->addr);
+    }
+    return handle->addr;
+}
+
+typedef struct _batch_item {
+    size_t index;
+    hash_t hash;
+    size_t bucket;
+} batch_item;
+
+/* how many lookups ahead we prefetch */
+#define BATCH_PREFETCH_DISTANCE 8
+/* the batch is bucket sorted by the upper bits of the home slot */
+#define BATCH_BUCKETS 256
+bool
+lookupSymbols_(Linker * l, char ** names, size_t n, addr_t * out) {
+    batch_item * items = calloc(n, sizeof(batch_item));
+    batch_item * sorted = calloc(n, sizeof(batch_item));
+    assert(n == 0 || (items != NULL && sorted != NULL));
+
+    /* one critical section for the whole batch; the lookups nest in it */
+    epoch_enter();
+    /* inserts may grow the table meanwhile: all buckets are taken against
+     * one snapshot of the slots, and computed once */
+    symbol_table_slots * slots = symbol_table_snapshot(&l->gsyms);
+    size_t capacity = slots == NULL ? 1 : slots->capacity;
+
+    /* hash all names, and count the lookups per region of the table */
+    size_t counts[BATCH_BUCKETS + 1] = { 0 };
+    for(size_t i = 0; i < n; i++) {
+        if(i + BATCH_PREFETCH_DISTANCE < n)
+            __builtin_prefetch(names[i + BATCH_PREFETCH_DISTANCE]);
+        items[i].index  = i;
+        items[i].hash   = hash(names[i]);
+        items[i].bucket = symbol_table_slot(slots, items[i].hash)
+                          * BATCH_BUCKETS / capacity;
+        counts[1 + items[i].bucket]++;
+    }
+    /* then walk the table front to back, rather than at random.  A linear
+     * bucket sort is sufficient for that; a full sort costs more than the
+     * locality gains. */
+    for(size_t b = 1; b <= BATCH_BUCKETS; b++)
+        counts[b] += counts[b - 1];
+    for(size_t i = 0; i < n; i++)
+        sorted[counts[items[i].bucket]++] = items[i];
+    free(items);
+    items = sorted;
+
+    for(size_t i = 0; i < n && i < BATCH_PREFETCH_DISTANCE; i++)
+        symbol_table_prefetch(&l->gsyms, items[i].hash);
+
+    bool failed = false;
+    size_t loaded = indexed_members_loaded(l);
+    for(size_t i = 0; i < n; i++) {
+        if(i + BATCH_PREFETCH_DISTANCE < n)
+            symbol_table_prefetch(&l->gsyms,
+                                  items[i + BATCH_PREFETCH_DISTANCE].hash);
+
+        size_t k = items[i].index;
+        GlobalSymbol * s = NULL;
+        if(!symbol_table_lookup(&l->gsyms, items[i].hash, names[k],
+                                (void**)&s)
+           || (!load_indexed_symbol(l, names[k], items[i].hash)
+               && !symbol_table_lookup(&l->gsyms, items[i].hash, names[k],
+                                       (void**)&s))) {
+            out[k] = s->symbol->addr;
+        } else if(lookup_system_symbols(l, names[k], items[i].hash, &out[k])) {
+            out[k] = 0x0;
+            failed = true;
+        }
+    }
+    epoch_exit();
+    free(items);
+    if(indexed_members_loaded(l) != loaded && resolvePending(l))
+        failed = true;
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 addr_t
 lookupGlobalSymbol_(char * name) {
     return lookupSymbol_(&LINKER, name);
 }
 
 
-void
-walk(binary_tree_node * n) {
-    if(n->left != NULL) walk(n->left);
-    GlobalSymbol *g = (GlobalSymbol *)n->value;
-    __link_log("%p %p %s\n", g->symbol->addr, g->symbol->got_addr,
+static void
+print_global_symbol(symbol_table_entry * e, void * ctx __attribute__((unused))) {
+    GlobalSymbol *g = (GlobalSymbol *)e->value;
+    __link_log("%p %p %s\n", (void*)g->symbol->addr,
+               (void*)g->symbol->got_addr,
                g->symbol->name);
-    if(n->right != NULL) walk(n->right);
 }
 void
 list_global_symbols() {
-    walk(LINKER.gsyms);
+    symbol_table_walk(&LINKER.gsyms, print_global_symbol, NULL);
+}
+
+void
+log_linker_stats(Linker * l) {
+    __link_log("Symbol name hashes: %lu computed, %lu deferred "
+               "(%lu of which were needed later)\n",
+               l->stats.hashes_computed, l->stats.hashes_deferred,
+               l->stats.hashes_deferred_computed);
+    __link_log("System symbol cache: %lu hits, %lu negative hits, "
+               "%lu misses (%lu entries); %lu misses resolved via .gnu.hash\n",
+               l->stats.syscache_hits, l->stats.syscache_negative_hits,
+               l->stats.syscache_misses, (unsigned long)l->syscache.count,
+               l->stats.dynsym_hits);
+    __link_log("Interned names: %lu distinct of %lu (%lu bytes)\n",
+               (unsigned long)l->names.set.count,
+               (unsigned long)l->names.requests,
+               (unsigned long)l->names.bytes);
+    __link_log("Read only sections mapped from files: %lu bytes\n",
+               l->stats.readonly_file_mapped);
+    __link_log("Object images: %lu released (%lu bytes), "
+               "%lu bytes of tables kept\n",
+               l->stats.images_released, l->stats.image_bytes_released,
+               l->stats.image_tables_kept);
+    __link_log("Huge page text: %lu bytes in %lu THP, %lu hugetlb regions "
+               "(%lu hugetlb fallbacks, %lu madvise failures)\n",
+               (unsigned long)l->code.bytes, l->code.thp_regions,
+               l->code.hugetlb_regions, l->code.hugetlb_fallbacks,
+               l->code.madvise_failures);
+    __link_log("Near code window: %lu of %lu bytes used%s, %lu overflows\n",
+               (unsigned long)l->code.window_used,
+               (unsigned long)l->code.window_size,
+               l->code.window_near ? " (near the host)" : "",
+               l->code.window_overflows);
+    __link_log("Stubs: %lu made of %lu reserved (%lu avoided)\n",
+               l->stats.stubs_made, l->stats.stubs_reserved,
+               l->stats.stubs_reserved - l->stats.stubs_made);
+    __link_log("Veneers: %lu made in islands, %lu branches shared one\n",
+               l->veneers.made, l->veneers.shared);
 }
 
 void
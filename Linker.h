@@ -3,10 +3,17 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include "Ar.h"
 //#include "MachO.h"
-#include "BinaryTree.h"
+#include "SymbolTable.h"
+#include "Intern.h"
+#include "Index.h"
+#include "AddrIndex.h"
+#include "CodeArena.h"
 #include "Types.h"
+#include "elf/dynsym.h"
+#include "elf/veneer.h"
 
 typedef struct _global_symbol {
     ElfSymbol * symbol;
@@ -15,16 +22,99 @@ typedef struct _global_symbol {
     struct _global_symbol *next;
 } GlobalSymbol;
 
+/*
+ * A resolved symbol.  Handles are hashed once; a handle to a global symbol
+ * points at the GlobalSymbol itself (which does not move, unlike the table
+ * slots), so re-resolving it is a load.
+ */
+typedef struct _symbol_handle {
+    const char   * name;    /* interned; the caller's copy may go */
+    hash_t         hash;
+    GlobalSymbol * symbol;  /* NULL for system symbols, or if not found */
+    addr_t         addr;
+} SymbolHandle;
+
+typedef struct _linker_stats {
+    /* symbol name hashes computed while loading objects */
+    unsigned long hashes_computed;
+    /* local, file and section symbols, whose hash was not computed */
+    unsigned long hashes_deferred;
+    /* deferred hashes that were computed on demand after all */
+    unsigned long hashes_deferred_computed;
+
+    /* system symbol (dlsym) cache */
+    unsigned long syscache_hits;
+    unsigned long syscache_negative_hits;
+    unsigned long syscache_misses;
+    /* cache misses answered from the registered libraries' .gnu.hash */
+    unsigned long dynsym_hits;
+
+    /* read only section bytes mapped from object files (LOAD_MAP_READONLY) */
+    unsigned long readonly_file_mapped;
+
+    /* object images released once their objects were published, and the
+     * bytes of tables copied out of all images (see release_image) */
+    unsigned long images_released;
+    unsigned long image_bytes_released;
+    unsigned long image_tables_kept;
+
+    /* stubs reserved behind text sections, and stubs actually made, by the
+     * objects resolved; the difference are branches that were in range */
+    unsigned long stubs_reserved;
+    unsigned long stubs_made;
+} LinkerStats;
+
 typedef struct _linker {
     /* all the known global symbols in the current linker session */
     GlobalSymbol * symbols;
 
-    /* global symbol table */
-    binary_tree_node * gsyms;
+    /* interned names of all symbols that take part in resolution */
+    interned_names names;
+
+    /* global symbol table; interned name -> GlobalSymbol */
+    symbol_table gsyms;
+    /* memoized system symbol lookups; name -> address, NULL if not found */
+    symbol_table syscache;
+    /* preloaded shared libraries, we can look up symbols in directly */
+    DynamicObjects dynobjs;
     /* all the objects loaded */
     ObjectCode * objects;
+    /* persistent symbol index; members are loaded from it on demand */
+    SymbolIndex * index;
+    /* address -> (object, section) for all loaded sections and GOTs */
+    addr_index ranges;
+    /* the near code window (LOAD_NEAR_CODE), and huge page backed text
+     * segments (LOAD_HUGE_TEXT) */
+    code_arena code;
+    /* veneers for out of range branches, shared across objects */
+    Veneers veneers;
+
+    /* LoadFlags for objects loaded from here on */
+    unsigned loadFlags;
+    /* LOAD_NEAR_HOST: an address in the host, NULL for the main executable;
+     * see code_arena_reserve */
+    void * hostAnchor;
+
+    LinkerStats stats;
+
+    /*
+     * Serializes everything that modifies the session: loading, resolving,
+     * inserting global symbols and filling the system symbol cache.  Lookups
+     * that hit gsyms or the system symbol cache don't take it; see
+     * SymbolTable.h.  The lock is reentrant (via lock_owner and lock_depth),
+     * and a zero initialized one is valid.
+     */
+    pthread_mutex_t lock;
+    pthread_t lock_owner;  /* 0 if not held; accessed atomically */
+    unsigned lock_depth;   /* the owner's */
 } Linker;
 
+void
+linker_lock(Linker * l);
+
+void
+linker_unlock(Linker * l);
+
 void
 addSection (Section *s, SectionKind kind, SectionAlloc alloc,
             addr_t start, unsigned size, unsigned mapped_offset,
@@ -39,21 +129,78 @@ insert_global_symbol(Linker * l, GlobalSymbol * symbol);
 void
 list_global_symbols();
 
+/* Print the session's statistics, unconditionally; callers on the normal
+ * path check link_log_enabled(LINK_LOG_DEBUG, ...) first. */
+void
+log_linker_stats(Linker * l);
+
+hash_t
+symbol_hash(Linker * l, ElfSymbol * symbol);
+
 addr_t
 lookupSymbol_(Linker *l, char * name);
 
 addr_t
 lookupGlobalSymbol_(char * name);
 
+addr_t
+lookup_symbol(Linker * l, const char * name, hash_t h);
+
+/* Resolve name into a handle; EXIT_FAILURE if the symbol can't be found. */
 bool
-lookup_system_symbols(const char * name, addr_t * addr);
+lookupSymbolHandle_(Linker * l, const char * name, SymbolHandle * handle);
+
+/* The (current) address of the handle's symbol. */
+addr_t
+symbolHandleAddr(Linker * l, SymbolHandle * handle);
+
+/*
+ * Look up n names at once.  out[i] is the address of names[i], or 0x0 if it
+ * can't be found, in which case EXIT_FAILURE is returned.
+ */
+bool
+lookupSymbols_(Linker * l, char ** names, size_t n, addr_t * out);
+
+bool
+lookup_system_symbols(Linker * l, const char * name, hash_t h, addr_t * addr);
+
+/*
+ * Drop cached system symbol lookups.  Negative results must be dropped
+ * whenever libraries are loaded (linkerDlopen does that), all results when
+ * libraries are unloaded.
+ */
+void
+flushSystemSymbolCache(Linker * l, bool negative_only);
+
+/*
+ * dlopen, and keep the system symbol cache consistent.  Libraries opened
+ * RTLD_GLOBAL are registered for direct .gnu.hash lookups.
+ */
+void *
+linkerDlopen(Linker * l, const char * path, int flags);
+
+/*
+ * Register an already loaded shared library (e.g. "libc.so") for direct
+ * .gnu.hash lookups.
+ */
+bool
+linkerIndexLibrary(Linker * l, const char * name);
+
+/*
+ * Release the session: its objects (see freeObjectCode), the global symbols
+ * they defined, its tables, veneers and code arena.  Global symbols inserted
+ * by the embedder, and an attached symbol index, are the embedder's.  No code
+ * or data of the session may be in use anymore; the session is zero
+ * initialized after, and may be used again.
+ */
+void
+linkerFree(Linker * l);
 
 bool
-lookup_global_symbol(binary_tree_node * gsyms, ElfSymbol * needle, addr_t *
-addr);
+lookup_global_symbol(symbol_table * gsyms, ElfSymbol * needle, addr_t * addr);
 
 bool
-lookup_global_symbol_(binary_tree_node * gsyms, char * name, addr_t * addr);
+lookup_global_symbol_(symbol_table * gsyms, char * name, addr_t * addr);
 
 
 struct object_code *
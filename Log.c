@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <android/log.h>
+
+#include "Log.h"
+
+unsigned __link_log_masks[LINK_LOG_LEVELS] = {
+        [LINK_LOG_ERROR] = LINK_LOG_ALL,
+        [LINK_LOG_WARN]  = LINK_LOG_ALL,
+        [LINK_LOG_INFO]  = LINK_LOG_ALL,
+};
+
+void
+link_log_configure(LogLevel level, unsigned categories) {
+    for(int l = LINK_LOG_WARN; l < LINK_LOG_LEVELS; l++)
+        __atomic_store_n(&__link_log_masks[l],
+                         l <= (int)level ? categories : 0, __ATOMIC_RELAXED);
+}
+
+/*
+ * The ring buffer.  Writers claim a message number off the head, and mark
+ * their record with it (plus one) once written; 0 while writing.  The
+ * drainer checks the mark before and after copying a record out, and skips
+ * records overwritten meanwhile.  A record written by two writers at once
+ * (the ring wrapped around a message being written) may come out garbled.
+ */
+typedef struct _log_record {
+    unsigned long seq;
+    char text[LINK_LOG_MESSAGE_SIZE];
+} log_record;
+
+static log_record    ring[LINK_LOG_RING_SIZE];
+static unsigned long ring_head;  /* messages claimed */
+static unsigned long ring_tail;  /* messages drained; the drainer's own */
+
+static bool to_stdio = true;
+static bool to_ring  = false;
+
+void
+link_log_to(bool stdio, bool ring) {
+    __atomic_store_n(&to_stdio, stdio, __ATOMIC_RELAXED);
+    __atomic_store_n(&to_ring, ring, __ATOMIC_RELAXED);
+}
+
+static void
+ring_write(const char * fmt, va_list ap) {
+    unsigned long n = __atomic_fetch_add(&ring_head, 1, __ATOMIC_RELAXED);
+    log_record * r = &ring[n & (LINK_LOG_RING_SIZE - 1)];
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    vsnprintf(r->text, sizeof(r->text), fmt, ap);
+    __atomic_store_n(&r->seq, n + 1, __ATOMIC_RELEASE);
+}
+
+size_t
+link_log_drain(void (*f)(const char * message, void * ctx), void * ctx) {
+    char text[LINK_LOG_MESSAGE_SIZE];
+    size_t drained = 0;
+    unsigned long head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    if(head - ring_tail > LINK_LOG_RING_SIZE)
+        ring_tail = head - LINK_LOG_RING_SIZE; /* the rest was overwritten */
+
+    for(; ring_tail < head; ring_tail++) {
+        log_record * r = &ring[ring_tail & (LINK_LOG_RING_SIZE - 1)];
+        unsigned long seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+        if(seq == 0 || seq < ring_tail + 1)
+            break; /* still being written; the next drain picks it up */
+        if(seq != ring_tail + 1)
+            continue; /* overwritten */
+        memcpy(text, r->text, sizeof(text));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&r->seq, __ATOMIC_RELAXED) != seq)
+            continue; /* overwritten while copying */
+        text[sizeof(text) - 1] = '\0';
+        f(text, ctx);
+        drained++;
+    }
+    return drained;
+}
+
+void __link_log(const char *fmt, ...)
+{
+    va_list ap;
+    if(__atomic_load_n(&to_ring, __ATOMIC_RELAXED)) {
+        va_start(ap, fmt);
+        ring_write(fmt, ap);
+        va_end(ap);
+    }
+    if(__atomic_load_n(&to_stdio, __ATOMIC_RELAXED)) {
+        va_start(ap, fmt);
+#if defined(__ANDROID__)
+        __android_log_vprint(ANDROID_LOG_FATAL, "SERV", fmt, ap);
+#else
+        vprintf(fmt, ap);
+#endif
+        va_end(ap);
+    }
+}
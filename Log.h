@@ -0,0 +1,87 @@
+#ifndef LINK_LOG_H
+#define LINK_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Leveled, category filtered logging.
+ *
+ *   link_log(LINK_LOG_DEBUG, LINK_LOG_RELOC, "fmt", ...);
+ *
+ * Messages above LINK_LOG_LEVEL are compiled out.  The others are filtered
+ * at runtime by a mask of categories per level (see link_log_configure); a
+ * message that is filtered costs a load and a branch, its arguments are not
+ * evaluated.  Code that prepares a message (formats a buffer, say) is
+ * guarded by link_log_enabled.
+ *
+ * Messages go to stdio (logcat on Android), and/or to a ring buffer of the
+ * last LINK_LOG_RING_SIZE messages, which is written without locks and
+ * read with link_log_drain.
+ *
+ * __link_log writes unconditionally; it is meant for output that was asked
+ * for, like the statistics and benchmark reports.
+ */
+typedef enum _LogLevel {
+    LINK_LOG_ERROR,  /* always enabled, in all categories */
+    LINK_LOG_WARN,
+    LINK_LOG_INFO,
+    LINK_LOG_DEBUG,
+    LINK_LOG_TRACE,  /* per section, relocation or stub */
+    LINK_LOG_LEVELS
+} LogLevel;
+
+typedef enum _LogCategory {
+    LINK_LOG_LOAD   = 1 << 0,  /* reading objects and archives, sections */
+    LINK_LOG_RELOC  = 1 << 1,  /* resolution and relocation */
+    LINK_LOG_STUB   = 1 << 2,  /* stubs and veneers */
+    LINK_LOG_SYMBOL = 1 << 3,  /* symbol lookup, the GOT */
+    LINK_LOG_INDEX  = 1 << 4,  /* the symbol index */
+    LINK_LOG_MEMORY = 1 << 5,  /* mappings and protection */
+    LINK_LOG_ALL    = ~0
+} LogCategory;
+
+#if !defined(LINK_LOG_LEVEL)
+#if defined(NDEBUG)
+#define LINK_LOG_LEVEL LINK_LOG_INFO
+#else
+#define LINK_LOG_LEVEL LINK_LOG_TRACE
+#endif
+#endif
+
+/* the enabled categories per level; see link_log_configure */
+extern unsigned __link_log_masks[LINK_LOG_LEVELS];
+
+#define link_log_enabled(level, category)                                    \
+    ((level) <= LINK_LOG_LEVEL                                               \
+     && (__atomic_load_n(&__link_log_masks[level], __ATOMIC_RELAXED)         \
+         & (category)))
+
+#define link_log(level, category, ...)                                       \
+    do {                                                                     \
+        if(link_log_enabled(level, category))                                \
+            __link_log(__VA_ARGS__);                                         \
+    } while(0)
+
+void __link_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/*
+ * Enable the given categories for all levels up to level, and disable all
+ * above.  By default, all categories are enabled up to LINK_LOG_INFO.
+ */
+void link_log_configure(LogLevel level, unsigned categories);
+
+#define LINK_LOG_RING_SIZE    1024  /* messages; a power of two */
+#define LINK_LOG_MESSAGE_SIZE 256   /* longer messages are truncated */
+
+/* Send messages to stdio, to the ring buffer, or both. */
+void link_log_to(bool stdio, bool ring);
+
+/*
+ * Call f on each message in the ring buffer not drained yet, oldest first,
+ * and return their number.  Messages overwritten before they were drained
+ * are lost.  There may be only one drainer at a time.
+ */
+size_t link_log_drain(void (*f)(const char * message, void * ctx), void * ctx);
+
+#endif //LINK_LOG_H
@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "Pool.h"
+
+/* the items [head, tail) not taken yet; the owner takes from the head,
+ * thieves from the tail */
+typedef struct _pool_share {
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+} pool_share;
+
+typedef struct _pool {
+    void    ** items;
+    pool_fn    f;
+    void     * ctx;
+    pool_share * shares;
+    unsigned   n_shares;
+    size_t     stolen;
+} pool;
+
+typedef struct _pool_worker {
+    pool   * p;
+    unsigned self;
+} pool_worker;
+
+static bool
+take(pool_share * s, bool front, size_t * i) {
+    pthread_mutex_lock(&s->lock);
+    bool taken = s->head < s->tail;
+    if(taken)
+        *i = front ? s->head++ : --s->tail;
+    pthread_mutex_unlock(&s->lock);
+    return taken;
+}
+
+static void *
+work(void * arg) {
+    pool_worker * w = arg;
+    pool * p = w->p;
+    size_t i;
+    for(;;) {
+        if(!take(&p->shares[w->self], true, &i)) {
+            /* items are never added; once all shares are empty, we're done */
+            bool stolen = false;
+            for(unsigned k = 1; k < p->n_shares && !stolen; k++)
+                stolen = take(&p->shares[(w->self + k) % p->n_shares], false,
+                              &i);
+            if(!stolen)
+                break;
+            __atomic_fetch_add(&p->stolen, 1, __ATOMIC_RELAXED);
+        }
+        p->f(p->items[i], p->ctx);
+    }
+    return NULL;
+}
+
+size_t
+pool_run(void ** items, size_t n, unsigned nthreads, pool_fn f, void * ctx) {
+    if(nthreads < 1) nthreads = 1;
+    if(nthreads > n) nthreads = n > 0 ? (unsigned)n : 1;
+
+    pool p = { .items = items, .f = f, .ctx = ctx, .n_shares = nthreads };
+    p.shares = calloc(nthreads, sizeof(pool_share));
+    pool_worker * workers = calloc(nthreads, sizeof(pool_worker));
+    pthread_t * threads = calloc(nthreads, sizeof(pthread_t));
+    assert(p.shares != NULL && workers != NULL && threads != NULL);
+    for(unsigned t = 0; t < nthreads; t++) {
+        pthread_mutex_init(&p.shares[t].lock, NULL);
+        p.shares[t].head = n * t / nthreads;
+        p.shares[t].tail = n * (t + 1) / nthreads;
+        workers[t] = (pool_worker){ .p = &p, .self = t };
+    }
+
+    /* worker 0 is this thread */
+    unsigned started = 1;
+    for(; started < nthreads; started++)
+        if(pthread_create(&threads[started], NULL, work, &workers[started]))
+            break; /* the others steal the rest */
+    work(&workers[0]);
+    for(unsigned t = 1; t < started; t++)
+        pthread_join(threads[t], NULL);
+
+    for(unsigned t = 0; t < nthreads; t++)
+        pthread_mutex_destroy(&p.shares[t].lock);
+    free(threads);
+    free(workers);
+    free(p.shares);
+    return p.stolen;
+}
@@ -0,0 +1,23 @@
+#ifndef LINK_POOL_H
+#define LINK_POOL_H
+
+#include <stddef.h>
+
+/*
+ * A work stealing pool.
+ *
+ * pool_run runs f over n items on nthreads threads (the calling thread
+ * included), and returns once all are done.  Each thread starts out with a
+ * contiguous share of the items, and takes them off the front; a thread out
+ * of work steals from the back of the others' shares, one item at a time, so
+ * that a few large items don't hold up the rest.  The order items are run in
+ * is not defined.  Should threads fail to start, their shares are stolen.
+ *
+ * Returns the number of items stolen.
+ */
+typedef void (*pool_fn)(void * item, void * ctx);
+
+size_t
+pool_run(void ** items, size_t n, unsigned nthreads, pool_fn f, void * ctx);
+
+#endif //LINK_POOL_H
@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "SymbolTable.h"
+#include "Epoch.h"
+
+const char symbol_table_tombstone[] = "(deleted)";
+
+/* keep the table at most 5/8 occupied (live entries + tombstones) */
+#define SYMBOL_TABLE_MIN_CAPACITY 64
+#define OVERLOADED(s, n) (((n) * 8) >= ((s)->capacity * 5))
+
+/*
+ * Map the hash onto a slot.  The knuth hash has rather weak low bits, hence
+ * we mix the full hash (fibonacci hashing) and take the upper bits.
+ */
+static inline size_t
+slot_for(const symbol_table_slots * slots, hash_t key) {
+    return (size_t)((key * 11400714819323198485ull) >> 32) & (slots->capacity - 1);
+}
+
+static inline bool
+same_name(const char * a, const char * b) {
+    return a == b || 0 == strcmp(a, b);
+}
+
+/* readers pair these acquires with the writer's releases */
+static inline symbol_table_slots *
+load_slots(symbol_table * table) {
+    return __atomic_load_n(&table->slots, __ATOMIC_ACQUIRE);
+}
+
+static inline const char *
+load_name(symbol_table_entry * e) {
+    return __atomic_load_n(&e->name, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+publish_name(symbol_table_entry * e, const char * name) {
+    __atomic_store_n(&e->name, name, __ATOMIC_RELEASE);
+}
+
+static symbol_table_slots *
+alloc_slots(size_t capacity) {
+    size_t cap = SYMBOL_TABLE_MIN_CAPACITY;
+    while(cap < capacity) cap <<= 1;
+
+    symbol_table_slots * slots = calloc(1, sizeof(symbol_table_slots)
+                                           + cap * sizeof(symbol_table_entry));
+    if(slots != NULL)
+        slots->capacity = cap;
+    return slots;
+}
+
+bool
+symbol_table_init(symbol_table * table, size_t capacity) {
+    symbol_table_slots * slots = alloc_slots(capacity);
+    if(slots == NULL)
+        return EXIT_FAILURE;
+    __atomic_store_n(&table->slots, slots, __ATOMIC_RELEASE);
+    table->count = 0;
+    table->tombstones = 0;
+    return EXIT_SUCCESS;
+}
+
+void
+symbol_table_free(symbol_table * table) {
+    symbol_table_slots * slots = table->slots;
+    __atomic_store_n(&table->slots, NULL, __ATOMIC_RELEASE);
+    table->count = 0;
+    table->tombstones = 0;
+    epoch_retire(slots, free);
+}
+
+size_t
+symbol_table_capacity(symbol_table * table) {
+    symbol_table_slots * slots = load_slots(table);
+    return slots == NULL ? 0 : slots->capacity;
+}
+
+static bool
+symbol_table_grow(symbol_table * table) {
+    symbol_table_slots * old = table->slots;
+
+    /* only double if the live entries demand it; otherwise we just shed the
+     * tombstones at the same size. */
+    size_t cap = old == NULL ? SYMBOL_TABLE_MIN_CAPACITY : old->capacity;
+    while(((table->count + 1) * 8) > (cap * 3)) cap <<= 1;
+
+    symbol_table_slots * slots = alloc_slots(cap);
+    if(slots == NULL)
+        return EXIT_FAILURE;
+
+    size_t count = 0;
+    for(size_t i = 0; old != NULL && i < old->capacity; i++) {
+        symbol_table_entry * e = &old->entries[i];
+        if(e->name == NULL || e->name == SYMBOL_TABLE_TOMBSTONE)
+            continue;
+        size_t j = slot_for(slots, e->hash);
+        while(slots->entries[j].name != NULL)
+            j = (j + 1) & (slots->capacity - 1);
+        slots->entries[j] = *e;
+        count++;
+    }
+    /* the new slots are complete before readers can see them */
+    __atomic_store_n(&table->slots, slots, __ATOMIC_RELEASE);
+    table->count = count;
+    table->tombstones = 0;
+    epoch_retire(old, free);
+    return EXIT_SUCCESS;
+}
+
+bool
+symbol_table_insert(symbol_table * table, hash_t key, const char * name,
+                    void * value) {
+    assert(name != NULL);
+
+    if(table->slots == NULL
+       || OVERLOADED(table->slots, table->count + table->tombstones + 1)) {
+        if(symbol_table_grow(table))
+            return EXIT_FAILURE;
+    }
+
+    /* tombstones are not reused: a concurrent reader may have matched the
+     * deleted name already, and would then read the new entry's value. */
+    symbol_table_slots * slots = table->slots;
+    size_t mask = slots->capacity - 1;
+    symbol_table_entry * e = NULL;
+    for(size_t i = slot_for(slots, key); ; i = (i + 1) & mask) {
+        e = &slots->entries[i];
+        if(e->name == NULL)
+            break;
+        if(e->hash == key
+           && e->name != SYMBOL_TABLE_TOMBSTONE
+           && same_name(e->name, name))
+            return EXIT_FAILURE; /* duplicate */
+    }
+
+    e->hash  = key;
+    e->value = value;
+    publish_name(e, name);
+    table->count++;
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Find the entry in the given slots, and copy it out.  Must be called inside
+ * an epoch critical section.
+ */
+static bool
+symbol_table_find(symbol_table_slots * slots, hash_t key, const char * name,
+                  symbol_table_entry * out) {
+    if(slots == NULL)
+        return false;
+    size_t mask = slots->capacity - 1;
+    for(size_t i = slot_for(slots, key); ; i = (i + 1) & mask) {
+        symbol_table_entry * e = &slots->entries[i];
+        const char * n = load_name(e);
+        if(n == NULL)
+            return false;
+        if(e->hash == key
+           && n != SYMBOL_TABLE_TOMBSTONE
+           && same_name(n, name)) {
+            out->hash  = e->hash;
+            out->name  = n;
+            out->value = e->value;
+            return true;
+        }
+    }
+}
+
+bool
+symbol_table_lookup(symbol_table * table, hash_t key, const char * name,
+                    void ** value) {
+    symbol_table_entry e;
+    epoch_enter();
+    bool found = symbol_table_find(load_slots(table), key, name, &e);
+    epoch_exit();
+    if(!found)
+        return EXIT_FAILURE;
+    *value = e.value;
+    return EXIT_SUCCESS;
+}
+
+bool
+symbol_table_lookup_key(symbol_table * table, hash_t key, const char * name,
+                        const char ** stored) {
+    symbol_table_entry e;
+    epoch_enter();
+    bool found = symbol_table_find(load_slots(table), key, name, &e);
+    epoch_exit();
+    if(!found)
+        return EXIT_FAILURE;
+    *stored = e.name;
+    return EXIT_SUCCESS;
+}
+
+bool
+symbol_table_delete(symbol_table * table, hash_t key, const char * name,
+                    void ** value) {
+    /* the writer owns the slots; no need to enter an epoch */
+    symbol_table_slots * slots = table->slots;
+    if(slots == NULL)
+        return EXIT_FAILURE;
+    size_t mask = slots->capacity - 1;
+    for(size_t i = slot_for(slots, key); ; i = (i + 1) & mask) {
+        symbol_table_entry * e = &slots->entries[i];
+        if(e->name == NULL)
+            return EXIT_FAILURE;
+        if(e->hash == key
+           && e->name != SYMBOL_TABLE_TOMBSTONE
+           && same_name(e->name, name)) {
+            if(value != NULL)
+                *value = e->value;
+            /* the value stays, for readers that matched the name already */
+            publish_name(e, SYMBOL_TABLE_TOMBSTONE);
+            table->count--;
+            table->tombstones++;
+            return EXIT_SUCCESS;
+        }
+    }
+}
+
+symbol_table_slots *
+symbol_table_snapshot(symbol_table * table) {
+    return load_slots(table);
+}
+
+size_t
+symbol_table_slot(const symbol_table_slots * slots, hash_t key) {
+    return slots == NULL ? 0 : slot_for(slots, key);
+}
+
+void
+symbol_table_prefetch(symbol_table * table, hash_t key) {
+    /* a prefetch can't fault; a retired array is harmless */
+    symbol_table_slots * slots = load_slots(table);
+    if(slots != NULL)
+        __builtin_prefetch(&slots->entries[slot_for(slots, key)]);
+}
+
+void
+symbol_table_walk(symbol_table * table,
+                  void (*f)(symbol_table_entry * entry, void * ctx),
+                  void * ctx) {
+    epoch_enter();
+    symbol_table_slots * slots = load_slots(table);
+    for(size_t i = 0; slots != NULL && i < slots->capacity; i++) {
+        symbol_table_entry * e = &slots->entries[i];
+        const char * n = load_name(e);
+        if(n == NULL || n == SYMBOL_TABLE_TOMBSTONE)
+            continue;
+        f(e, ctx);
+    }
+    epoch_exit();
+}
@@ -0,0 +1,109 @@
+#ifndef SymbolTable_h
+#define SymbolTable_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "Hash.h"
+
+/*
+ * Open addressing hash table, keyed by symbol name.
+ *
+ * The table keeps a flat array of (hash, name, value) slots and uses linear
+ * probing.  The full 64bit hash is stored next to the name, such that most
+ * probes never have to touch the name; only if the hashes agree, the names are
+ * compared.  Thus two distinct names with the same hash can coexist.
+ *
+ * Deleted slots are marked with a tombstone.  Tombstones are dropped whenever
+ * the table is rehashed, which happens once live entries and tombstones fill
+ * it up.
+ *
+ * A zero initialized symbol_table is a valid empty table.
+ *
+ * Names are compared by pointer first; for interned names (see Intern.h)
+ * that is the only comparison on a hit.
+ *
+ * Concurrency: there may be one writer (insert, delete, free) at a time, and
+ * any number of readers (lookup, walk) alongside it; readers never lock or
+ * wait.  An entry is written before its name is published, and is never
+ * modified afterwards, except that its name may be replaced by a tombstone.
+ * Rehashing builds a new slot array, publishes it, and hands the old one to
+ * epoch_retire (see Epoch.h); readers access the slots inside epoch critical
+ * sections.  Whatever a name or value points to must outlive concurrent
+ * readers as well; retire it, rather than freeing it right away.
+ */
+typedef struct _symbol_table_entry {
+    hash_t       hash;
+    const char * name;  /* NULL: empty, SYMBOL_TABLE_TOMBSTONE: deleted */
+    void       * value;
+} symbol_table_entry;
+
+typedef struct _symbol_table_slots {
+    size_t capacity;    /* always a power of two */
+    symbol_table_entry entries[];
+} symbol_table_slots;
+
+typedef struct _symbol_table {
+    symbol_table_slots * slots;  /* NULL for an empty table */
+    size_t count;       /* live entries */
+    size_t tombstones;  /* deleted entries */
+} symbol_table;
+
+extern const char symbol_table_tombstone[];
+#define SYMBOL_TABLE_TOMBSTONE (symbol_table_tombstone)
+
+bool
+symbol_table_init(symbol_table * table, size_t capacity);
+
+void
+symbol_table_free(symbol_table * table);
+
+/* the number of slots; 0 for an empty table */
+size_t
+symbol_table_capacity(symbol_table * table);
+
+/*
+ * Insert the value under the name.  Returns EXIT_FAILURE if there already is
+ * an entry with the same name.  The name is not copied, and must outlive the
+ * entry.
+ */
+bool
+symbol_table_insert(symbol_table * table, hash_t key, const char * name,
+                    void * value);
+
+bool
+symbol_table_lookup(symbol_table * table, hash_t key, const char * name,
+                    void ** value);
+
+/* like symbol_table_lookup, but yields the name stored in the table */
+bool
+symbol_table_lookup_key(symbol_table * table, hash_t key, const char * name,
+                        const char ** stored);
+
+bool
+symbol_table_delete(symbol_table * table, hash_t key, const char * name,
+                    void ** value);
+
+/*
+ * The current slot array, NULL for an empty table, and the home slot of the
+ * key in it; and a prefetch hint for the key.  Used to order and overlap
+ * batches of lookups.  The snapshot is valid inside an epoch critical section
+ * only, and may be replaced by a concurrent insert at any time: take one per
+ * batch, so that all its keys are placed against the same capacity.
+ */
+symbol_table_slots *
+symbol_table_snapshot(symbol_table * table);
+
+size_t
+symbol_table_slot(const symbol_table_slots * slots, hash_t key);
+
+void
+symbol_table_prefetch(symbol_table * table, hash_t key);
+
+/* call f for each live entry, in slot order, on a snapshot of the slots */
+void
+symbol_table_walk(symbol_table * table,
+                  void (*f)(symbol_table_entry * entry, void * ctx),
+                  void * ctx);
+
+#endif /* SymbolTable_h */
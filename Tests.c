@@ -1,13 +1,23 @@
 #include <stdio.h>
+#include <string.h>
 #include "Tests.h"
+#include "Bench.h"
 
 #include "Linker.h"
 #include "Elf.h"
+#include "Epoch.h"
+#include "elf/plt.h"
+#include "elf/reloc/decode.h"
+#include "elf/reloc/arm_relocs.h"
+#include "elf/reloc/arm64_relocs.h"
 #include "debug.h"
 
 #include <libgen.h>
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <pthread.h>
 #include <android/log.h>
 
 static void ___log(const char *fmt, ...)
@@ -200,9 +210,10 @@ testLoadHS(finder findFile) {
 
     if(findFile(charset, sizeof(charset), "libcharset", "so"))
     abort();
-    dlopen(charset, RTLD_NOW | RTLD_GLOBAL);
+    linkerDlopen(&LINKER, charset, RTLD_NOW | RTLD_GLOBAL);
     if(findFile(iconv, sizeof(iconv), "libiconv", "so")) abort();
-    dlopen(iconv, RTLD_NOW | RTLD_GLOBAL);
+    linkerDlopen(&LINKER, iconv, RTLD_NOW | RTLD_GLOBAL);
+    linkerIndexLibrary(&LINKER, "libc.so");
 
 
     char * archives[] = {
@@ -232,6 +243,7 @@ testLoadHS(finder findFile) {
                     .elf_sym = NULL,
                     .name = "__exidx_start",
                     .hash = hash("__exidx_start"),
+                    .hash_valid = true,
                     .addr = 0x1,
                     .got_addr = 0x0
             },
@@ -244,6 +256,7 @@ testLoadHS(finder findFile) {
                     .elf_sym = NULL,
                     .name = "__exidx_end",
                     .hash = hash("__exidx_end"),
+                    .hash_valid = true,
                     .addr = 0x1,
                     .got_addr = 0x0
             },
@@ -258,6 +271,7 @@ testLoadHS(finder findFile) {
                     .elf_sym = NULL,
                     .name = "atexit",
                     .hash = hash("atexit"),
+                    .hash_valid = true,
                     .addr = (addr_t)&atexit,
                     .got_addr = 0x0
             },
@@ -318,3 +332,1175 @@ testLoadHS(finder findFile) {
     ___log("================================================================================\n");
     return EXIT_SUCCESS;
 }
+
+bool
+testSymbolTable(finder findFile __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: symbol table\n");
+
+    symbol_table t = { 0 };
+    char names[1000][16];
+    for(unsigned i=0; i < 1000; i++) {
+        snprintf(names[i], sizeof(names[i]), "sym_%u", i);
+        /* force collisions: every 10 names share a hash */
+        if(symbol_table_insert(&t, i / 10, names[i], names[i])) abort();
+    }
+    if(!symbol_table_insert(&t, 0, "sym_0", NULL)) abort(/* duplicate */);
+    if(t.count != 1000) abort();
+
+    for(unsigned i=0; i < 1000; i++) {
+        void * v = NULL;
+        if(symbol_table_lookup(&t, i / 10, names[i], &v)) abort();
+        if(v != names[i]) abort();
+    }
+    for(unsigned i=0; i < 1000; i += 2)
+        if(symbol_table_delete(&t, i / 10, names[i], NULL)) abort();
+    for(unsigned i=0; i < 1000; i++) {
+        void * v = NULL;
+        bool missing = symbol_table_lookup(&t, i / 10, names[i], &v);
+        if(missing != (i % 2 == 0)) abort();
+    }
+    /* deleted slots can be reused */
+    for(unsigned i=0; i < 1000; i += 2)
+        if(symbol_table_insert(&t, i / 10, names[i], names[i])) abort();
+    if(t.count != 1000) abort();
+    symbol_table_free(&t);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testHash(finder findFile __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: hash\n");
+
+    /* place strings right before an inaccessible page; the word at a time
+     * hash must neither fault nor produce a different hash there. */
+    long page = sysconf(_SC_PAGESIZE);
+    char * mem = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+                      MAP_ANON | MAP_PRIVATE, -1, 0);
+    if(mem == MAP_FAILED) abort();
+    if(mprotect(mem + page, page, PROT_NONE)) abort();
+
+    char str[128];
+    for(unsigned len = 0; len < sizeof(str); len++) {
+        for(unsigned i = 0; i < len; i++)
+            str[i] = (char)('a' + (i * 7 + len) % 26);
+        str[len] = '\0';
+        hash_t h = hash(str);
+
+        char * tail = mem + page - (len + 1);
+        memcpy(tail, str, len + 1);
+        if(hash(tail) != h) abort();
+        for(unsigned off = 1; off < 16; off++) {
+            memcpy(mem + off, str, len + 1);
+            if(hash(mem + off) != h) abort();
+        }
+        if(len > 0) {
+            str[len - 1] ^= 1;
+            if(hash(str) == h) abort();
+        }
+    }
+    munmap(mem, 2 * page);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testSystemSymbolCache(finder findFile __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: system symbol cache\n");
+
+    Linker l = { 0 };
+    char * missing = "__link_no_such_symbol__";
+
+    if(lookupSymbol_(&l, "memcpy") != (addr_t)dlsym(RTLD_DEFAULT, "memcpy"))
+        abort();
+    if(lookupSymbol_(&l, "memcpy") != (addr_t)dlsym(RTLD_DEFAULT, "memcpy"))
+        abort();
+    if(lookupSymbol_(&l, missing) != 0x0) abort();
+    if(lookupSymbol_(&l, missing) != 0x0) abort();
+
+    if(l.stats.syscache_misses != 2) abort();
+    if(l.stats.syscache_hits != 1) abort();
+    if(l.stats.syscache_negative_hits != 1) abort();
+
+    /* dropping the negative entries keeps memcpy */
+    flushSystemSymbolCache(&l, true);
+    if(l.syscache.count != 1) abort();
+    if(lookupSymbol_(&l, missing) != 0x0) abort();
+    if(l.stats.syscache_misses != 3) abort();
+
+    /* a handle not found keeps its name, not the caller's, for later */
+    char late[] = "__link_late_symbol__";
+    SymbolHandle handle;
+    if(!lookupSymbolHandle_(&l, late, &handle)) abort(/* not there yet */);
+    memset(late, 'x', sizeof(late) - 1);
+    ElfSymbol symbol = { .name = "__link_late_symbol__", .addr = 0x1234 };
+    GlobalSymbol global = { .symbol = &symbol };
+    if(!insert_global_symbol(&l, &global)) abort();
+    if(symbolHandleAddr(&l, &handle) != 0x1234) abort();
+    if(handle.symbol != &global) abort();
+
+    flushSystemSymbolCache(&l, false);
+    if(l.syscache.count != 0) abort();
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+/* interposes libc's, for testDynamicSymbols; the same, bit by bit */
+int
+ffs(int i) {
+    for(int k = 0; k < 32; k++)
+        if((unsigned)i & (1u << k))
+            return k + 1;
+    return 0;
+}
+
+bool
+testDynamicSymbols(finder findFile __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: .gnu.hash lookups\n");
+
+    /* index the libc we are linked against, and compare with dlsym */
+    Dl_info info;
+    if(0 == dladdr((void*)&qsort, &info)) abort();
+
+    DynamicObjects d = { 0 };
+    if(dynamic_objects_register(&d, info.dli_fname)) abort();
+
+    char * names[] = { "qsort", "malloc", "free", "fopen", "atexit",
+                       "memcpy", "__link_no_such_symbol__" };
+    unsigned found = 0;
+    for(unsigned i=0; i < sizeof(names)/sizeof(char*); i++) {
+        addr_t addr = 0x0;
+        switch(dynamic_objects_lookup(&d, names[i], &addr)) {
+            case DYNSYM_FOUND:
+                if(addr != (addr_t)dlsym(RTLD_DEFAULT, names[i])) abort();
+                found++;
+                break;
+            case DYNSYM_NOT_FOUND:
+            case DYNSYM_UNKNOWN:
+                break;
+        }
+    }
+    ___log("%u of %u symbols found in %s\n", found,
+           (unsigned)(sizeof(names)/sizeof(char*)), info.dli_fname);
+    if(found == 0) abort();
+    dynamic_objects_free(&d);
+
+    /* ffs is defined by libc and by us (below); whichever comes first in
+     * the global scope wins, with both registered, and with either */
+    Dl_info self;
+    if(0 == dladdr((void*)&testDynamicSymbols, &self)) abort();
+    addr_t expected = (addr_t)dlsym(RTLD_DEFAULT, "ffs");
+    if(expected == 0x0) abort();
+    const char * libs[][2] = { { info.dli_fname, self.dli_fname },
+                               { info.dli_fname, NULL },
+                               { self.dli_fname, NULL } };
+    for(unsigned i = 0; i < sizeof(libs)/sizeof(libs[0]); i++) {
+        DynamicObjects both = { 0 };
+        for(unsigned k = 0; k < 2 && libs[i][k] != NULL; k++)
+            if(dynamic_objects_register(&both, libs[i][k])) abort();
+        addr_t addr = 0x0;
+        DynLookup r = dynamic_objects_lookup(&both, "ffs", &addr);
+        if(r == DYNSYM_NOT_FOUND) abort(/* defined twice */);
+        if(r == DYNSYM_FOUND && addr != expected) abort(/* interposed */);
+        dynamic_objects_free(&both);
+    }
+    Linker l = { .objects = NULL };
+    if(linkerIndexLibrary(&l, info.dli_fname)) abort();
+    if(lookupSymbol_(&l, "ffs") != expected) abort();
+    flushSystemSymbolCache(&l, false);
+    dynamic_objects_free(&l.dynobjs);
+    ___log("ffs: %s\n", expected == (addr_t)&ffs ? "ours" : "libc's");
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testIntern(finder findFile __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: interned names\n");
+
+    interned_names names = { .set = { 0 } };
+    char a[] = "base_GHCziBase_zdfMonadIO_closure";
+    char b[] = "base_GHCziBase_zdfMonadIO_closure";
+
+    const char * ia = intern_name(&names, a, hash(a));
+    const char * ib = intern_name(&names, b, hash(b));
+    if(ia != ib || ia == a || 0 != strcmp(ia, a)) abort();
+    if(find_interned(&names, b, hash(b)) != ia) abort();
+    if(find_interned(&names, "nope", hash("nope")) != NULL) abort();
+    if(names.set.count != 1 || names.requests != 2) abort();
+
+    /* more than fits into a single chunk */
+    char buf[32];
+    for(unsigned i=0; i < 10000; i++) {
+        snprintf(buf, sizeof(buf), "sym_%u", i);
+        const char * s = intern_name(&names, buf, hash(buf));
+        if(0 != strcmp(s, buf)) abort();
+    }
+    if(names.set.count != 10001) abort();
+    if(0 != strcmp(ia, a)) abort();
+    interned_names_free(&names);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testSymbolIndex(finder findFile) {
+    ___log("================================================================================\n");
+    ___log("Test: symbol index\n");
+
+    char lib[128];  memset(lib, 0, sizeof lib);
+    char path[160]; memset(path, 0, sizeof path);
+
+    if(findFile(lib, sizeof(lib), "lib", "a")) abort();
+    snprintf(path, sizeof(path), "%s.idx", lib);
+
+    /* cold: a private session that loads the whole archive */
+    Linker cold = { .objects = NULL };
+    loadArchive(&cold, lib);
+    if(writeSymbolIndex(&cold, path)) abort();
+
+    /* warm: a session with nothing but the index */
+    SymbolIndex * idx = loadSymbolIndex(path, true);
+    if(idx == NULL) abort();
+    if(idx->header->n_members != count_objects(&cold)) abort();
+
+    Linker warm = { .objects = NULL };
+    attachSymbolIndex(&warm, idx);
+    if(count_objects(&warm) != 0) abort();
+
+    int (*quad)(int) = (void*)lookupSymbol_(&warm, "quad");
+    if(quad == NULL) abort();
+    if(idx->n_loaded == 0) abort();
+    ___log("quad: %d (%d of %d objects loaded)\n", quad(2),
+           count_objects(&warm), count_objects(&cold));
+    for(ObjectCode *o = warm.objects; o != NULL; o = o->next)
+        if(o->status != OBJECT_RESOLVED) abort();
+
+    /* an index from a different format version is rejected */
+    FILE * f = fopen(path, "r+b");
+    if(f == NULL) abort();
+    fseek(f, offsetof(index_header, version), SEEK_SET);
+    fputc(0xff, f);
+    fclose(f);
+    if(loadSymbolIndex(path, false) != NULL) abort();
+    unlink(path);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+typedef struct _concurrent_lookup {
+    Linker * l;
+    char (* names)[24];
+    unsigned n_names;
+    unsigned n_published;  /* the names published before readers started */
+    bool     inserting;    /* set while the writer is still inserting */
+    unsigned failures;
+} concurrent_lookup;
+
+static void *
+concurrent_reader(void * arg) {
+    concurrent_lookup * c = arg;
+    while(__atomic_load_n(&c->inserting, __ATOMIC_ACQUIRE)) {
+        for(unsigned i = 0; i < c->n_names; i++) {
+            GlobalSymbol * g = NULL;
+            bool missing = symbol_table_lookup(&c->l->gsyms, hash(c->names[i]),
+                                               c->names[i], (void**)&g);
+            /* published names must be found, all others found correctly */
+            if(missing ? i < c->n_published
+                       : g->symbol->addr != (addr_t)(i + 1))
+                __atomic_fetch_add(&c->failures, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+/* batches of the published names, bucketed against a growing table */
+static void *
+concurrent_batch_reader(void * arg) {
+    concurrent_lookup * c = arg;
+    char ** batch = calloc(c->n_published, sizeof(char *));
+    addr_t * out = calloc(c->n_published, sizeof(addr_t));
+    if(batch == NULL || out == NULL) abort();
+    for(unsigned i = 0; i < c->n_published; i++)
+        batch[i] = c->names[i];
+    while(__atomic_load_n(&c->inserting, __ATOMIC_ACQUIRE)) {
+        bool failed = lookupSymbols_(c->l, batch, c->n_published, out);
+        for(unsigned i = 0; i < c->n_published; i++)
+            if(failed || out[i] != (addr_t)(i + 1))
+                __atomic_fetch_add(&c->failures, 1, __ATOMIC_RELAXED);
+    }
+    free(batch);
+    free(out);
+    return NULL;
+}
+
+bool
+testConcurrentLookup(finder findFile __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: concurrent lookups\n");
+
+    enum { N = 20000, READERS = 4 };
+    static char names[N][24];
+    static ElfSymbol symbols[N];
+    static GlobalSymbol globals[N];
+
+    Linker l = { 0 };
+    for(unsigned i = 0; i < N; i++) {
+        snprintf(names[i], sizeof(names[i]), "sym_%u", i);
+        symbols[i] = (ElfSymbol){ .name = names[i], .hash = hash(names[i]),
+                                  .hash_valid = true, .addr = (addr_t)(i + 1) };
+        globals[i] = (GlobalSymbol){ .symbol = &symbols[i] };
+    }
+    concurrent_lookup c = { .l = &l, .names = names, .n_names = N,
+                            .n_published = N / 8, .inserting = true };
+    for(unsigned i = 0; i < c.n_published; i++)
+        if(!insert_global_symbol(&l, &globals[i])) abort();
+
+    /* the remaining inserts grow the table several times under the readers,
+     * single lookups and batches alike */
+    pthread_t readers[READERS + 1];
+    for(unsigned i = 0; i < READERS; i++)
+        if(pthread_create(&readers[i], NULL, concurrent_reader, &c)) abort();
+    if(pthread_create(&readers[READERS], NULL, concurrent_batch_reader, &c))
+        abort();
+    for(unsigned i = c.n_published; i < N; i++)
+        if(!insert_global_symbol(&l, &globals[i])) abort();
+    __atomic_store_n(&c.inserting, false, __ATOMIC_RELEASE);
+    for(unsigned i = 0; i <= READERS; i++)
+        pthread_join(readers[i], NULL);
+
+    if(c.failures != 0) abort();
+    for(unsigned i = 0; i < N; i++)
+        if(lookupSymbol_(&l, names[i]) != (addr_t)(i + 1)) abort();
+    if(epoch_collect() != 0) abort(/* no readers left */);
+    symbol_table_free(&l.gsyms);
+    interned_names_free(&l.names);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testParallelArchive(finder findFile) {
+    ___log("================================================================================\n");
+    ___log("Test: parallel archive loading\n");
+
+    char lib[128];  memset(lib, 0, sizeof lib);
+    if(findFile(lib, sizeof(lib), "lib", "a")) abort();
+
+    /* the same archive, into two private sessions */
+    Linker serial = { .objects = NULL };
+    Linker parallel = { .objects = NULL };
+    loadArchive(&serial, lib);
+    loadArchiveParallel(&parallel, lib, 4);
+
+    if(serial.gsyms.count != parallel.gsyms.count) abort();
+    if(serial.names.set.count != parallel.names.set.count) abort();
+    ObjectCode *a = serial.objects, *b = parallel.objects;
+    for(; a != NULL && b != NULL; a = a->next, b = b->next) {
+        /* same members, in the same order, publishing the same names */
+        if(0 != strcmp(a->archiveMemberName, b->archiveMemberName)) abort();
+        if(a->n_symbols != b->n_symbols) abort();
+        /* member buffers are released once published */
+        if(a->image != NULL || b->image != NULL) abort();
+        for(unsigned i = 0; i < a->n_symbols; i++) {
+            if((a->symbols[i] == NULL) != (b->symbols[i] == NULL)) abort();
+            if(a->symbols[i] != NULL
+               && 0 != strcmp(a->symbols[i], b->symbols[i])) abort();
+        }
+        if(a->info->got_size != b->info->got_size) abort();
+    }
+    if(a != NULL || b != NULL) abort();
+
+    if(resolvePending(&parallel)) abort();
+    int (*quad)(int) = (void*)lookupSymbol_(&parallel, "quad");
+    if(quad == NULL) abort();
+    ___log("quad: %d\n", quad(2));
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testAddressIndex(finder findFile) {
+    ___log("================================================================================\n");
+    ___log("Test: address index\n");
+
+    char lib[128];  memset(lib, 0, sizeof lib);
+    if(findFile(lib, sizeof(lib), "lib", "a")) abort();
+
+    Linker l = { .objects = NULL };
+    loadArchive(&l, lib);
+
+    unsigned ranges = 0;
+    for(ObjectCode *oc = l.objects; oc != NULL; oc = oc->next) {
+        for(unsigned i = 0; i < oc->n_sections; i++) {
+            Section * s = &oc->sections[i];
+            if(s->size == 0) continue;
+            OcInfo first = find_section(&l, s->start);
+            OcInfo last  = find_section(&l, s->start + s->size - 1);
+            if(first.oc != oc || first.section != s) abort();
+            if(last.oc != oc || last.section != s) abort();
+            ranges++;
+        }
+        if(oc->info->got_size > 0) {
+            addr_t got = oc->info->got_start;
+            if(find_oc_for_GOT_addr(&l, got) != oc) abort();
+            if(find_oc_for_GOT_addr(&l, got + oc->info->got_size - 1) != oc)
+                abort();
+            if(find_section(&l, got).oc != NULL) abort();
+            ranges++;
+        }
+    }
+    if(ranges != l.ranges.committed->n) abort();
+
+    /* unloading drops all of the object's ranges */
+    ObjectCode * oc = l.objects;
+    addr_index_remove_object(&l.ranges, oc);
+    for(unsigned i = 0; i < oc->n_sections; i++)
+        if(oc->sections[i].size > 0
+           && find_section(&l, oc->sections[i].start).oc != NULL)
+            abort();
+    addr_index_free(&l.ranges);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testLoadFromMemory(finder findFile) {
+    ___log("================================================================================\n");
+    ___log("Test: load from memory\n");
+
+    char lib[128];  memset(lib, 0, sizeof lib);
+    if(findFile(lib, sizeof(lib), "lib", "o")) abort();
+
+    FILE * f = fopen(lib, "rb");
+    if(f == NULL) abort();
+    fseek(f, 0, SEEK_END);
+    size_t size = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t * image = malloc(size);
+    if(image == NULL || fread(image, size, 1, f) != 1) abort();
+    fclose(f);
+
+    /* not an object */
+    Linker bad = { .objects = NULL };
+    if(loadObjectFromMemory(&bad, "bad", (uint8_t *)"junk", 4, IMAGE_COPY))
+        abort();
+
+    /* headers that don't add up are refused before they are parsed */
+    uint8_t * crafted = malloc(size);
+    if(crafted == NULL) abort();
+    ElfEhdr * ehdr = (ElfEhdr *)crafted;
+    for(int k = 0; k < 4; k++) {
+        memcpy(crafted, image, size);
+        switch(k) {
+            case 0: ehdr->e_machine = EM_NONE; break;
+            case 1: ehdr->e_shentsize = sizeof(ElfShdr) + 8; break;
+            case 2: ehdr->e_shstrndx = ehdr->e_shnum; break;
+            /* e_shoff + e_shnum * sizeof(ElfShdr) wraps around */
+            case 3: ehdr->e_shoff = -(__typeof__(ehdr->e_shoff))sizeof(ElfShdr);
+                    ehdr->e_shnum = 2; break;
+        }
+        if(loadObjectFromMemory(&bad, "crafted", crafted, size, IMAGE_BORROW))
+            abort();
+    }
+    free(crafted);
+    if(bad.objects != NULL) abort();
+
+    /* once published, no object holds on to its image; even a borrowed one
+     * can go before resolving */
+
+    /* borrowed: handed back, not freed */
+    uint8_t * lent = malloc(size);
+    if(lent == NULL) abort();
+    memcpy(lent, image, size);
+    Linker borrowed = { .objects = NULL };
+    ObjectCode * a = loadObjectFromMemory(&borrowed, "lib.o", lent, size,
+                                          IMAGE_BORROW);
+    if(a == NULL || a->image != NULL || !a->imageBorrowed) abort();
+    if(borrowed.stats.images_released != 0) abort();
+    if(borrowed.stats.image_tables_kept == 0) abort();
+    memset(lent, 0xa5, size);
+    free(lent);
+    if(resolveObject(&borrowed, a)) abort();
+
+    /* copied: the image can go right away; it is trashed before resolving */
+    uint8_t * scratch = malloc(size);
+    if(scratch == NULL) abort();
+    memcpy(scratch, image, size);
+    Linker copied = { .objects = NULL };
+    ObjectCode * b = loadObjectFromMemory(&copied, "lib.o", scratch, size,
+                                          IMAGE_COPY);
+    if(b == NULL || b->image != NULL || b->imageBorrowed) abort();
+    if(copied.stats.images_released != 1) abort();
+    memset(scratch, 0xa5, size);
+    free(scratch);
+    if(resolveObject(&copied, b)) abort();
+
+    /* adopted: used in place, and freed once published */
+    uint8_t * adoptee = malloc(size);
+    if(adoptee == NULL) abort();
+    memcpy(adoptee, image, size);
+    Linker adopted = { .objects = NULL };
+    ObjectCode * c = loadObjectFromMemory(&adopted, "lib.o", adoptee, size,
+                                          IMAGE_ADOPT);
+    if(c == NULL || c->image != NULL || c->imageBorrowed) abort();
+    if(adopted.stats.images_released != 1
+       || adopted.stats.image_bytes_released != size) abort();
+    if(resolveObject(&adopted, c)) abort();
+
+    /* misaligned: borrowed ones are copied, adopted ones refused */
+    uint8_t * unaligned = malloc(size + 1);
+    if(unaligned == NULL) abort();
+    memcpy(unaligned + 1, image, size);
+    if(loadObjectFromMemory(&bad, "lib.o", unaligned + 1, size, IMAGE_ADOPT))
+        abort();
+    Linker realigned = { .objects = NULL };
+    ObjectCode * d = loadObjectFromMemory(&realigned, "lib.o", unaligned + 1,
+                                          size, IMAGE_BORROW);
+    if(d == NULL || d->image != NULL || d->imageBorrowed) abort();
+    if(realigned.stats.images_released != 1) abort();
+    free(unaligned);
+    if(resolveObject(&realigned, d)) abort();
+
+    int (*fa)(int, int) = (void*)lookupSymbol_(&borrowed, "ml_func");
+    int (*fb)(int, int) = (void*)lookupSymbol_(&copied, "ml_func");
+    int (*fc)(int, int) = (void*)lookupSymbol_(&adopted, "ml_func");
+    int (*fd)(int, int) = (void*)lookupSymbol_(&realigned, "ml_func");
+    if(fa == NULL || fb == NULL || fc == NULL || fd == NULL || fa == fb)
+        abort();
+    if(fa(2, 3) != fb(2, 3) || fa(2, 3) != fc(2, 3) || fa(2, 3) != fd(2, 3))
+        abort();
+    ___log("ml_func: %d\n", fb(2, 3));
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testSectionLayout(finder findFile) {
+    ___log("================================================================================\n");
+    ___log("Test: section layout\n");
+
+    char lib[128];  memset(lib, 0, sizeof lib);
+    if(findFile(lib, sizeof(lib), "lib", "a")) abort();
+
+    Linker l = { .objects = NULL };
+    loadArchive(&l, lib);
+
+    for(ObjectCode *oc = l.objects; oc != NULL; oc = oc->next) {
+        ObjectCodeFormatInfo * info = oc->info;
+        for(unsigned i = 0; i < oc->n_sections; i++) {
+            Section * s = &oc->sections[i];
+            if(s->alloc != SECTION_MMAP) continue;
+            /* inside its segment, which is inside the object's mapping */
+            if(s->start < s->mapped_start
+               || s->start + s->size > s->mapped_start + s->mapped_size)
+                abort();
+            if(s->mapped_start < info->mapping
+               || s->mapped_start + s->mapped_size
+                  > info->mapping + info->mapping_size)
+                abort();
+            size_t align = s->info->sectionHeader->sh_addralign;
+            if(align > 1 && 0 != (s->start & (align - 1))) abort();
+            if(s->info->stub_size > 0
+               && (s->info->stub_offset < s->start + s->size
+                   || s->info->stub_offset + s->info->stub_size
+                      > s->mapped_start + s->mapped_size))
+                abort();
+            /* no overlap with any other section */
+            for(unsigned j = i + 1; j < oc->n_sections; j++) {
+                Section * t = &oc->sections[j];
+                if(t->alloc != SECTION_MMAP) continue;
+                if(s->start < t->start + t->size && t->start < s->start + s->size)
+                    abort();
+            }
+        }
+    }
+    if(resolvePending(&l)) abort();
+    int (*quad)(int) = (void*)lookupSymbol_(&l, "quad");
+    if(quad == NULL) abort();
+    ___log("quad: %d\n", quad(2));
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testFileBackedRodata(finder findFile) {
+    ___log("================================================================================\n");
+    ___log("Test: file backed read only sections\n");
+
+    char lib[128];  memset(lib, 0, sizeof lib);
+    if(findFile(lib, sizeof(lib), "lib", "a")) abort();
+
+    /* the same archive, copied and mapped from the file */
+    Linker copied = { .objects = NULL };
+    Linker mapped = { .objects = NULL, .loadFlags = LOAD_MAP_READONLY };
+    loadArchive(&copied, lib);
+    loadArchive(&mapped, lib);
+
+    ObjectCode *a = copied.objects, *b = mapped.objects;
+    for(; a != NULL && b != NULL; a = a->next, b = b->next) {
+        if(a->info->file_mapped != 0) abort();
+        if(a->n_sections != b->n_sections) abort();
+        for(unsigned i = 0; i < a->n_sections; i++) {
+            Section * s = &a->sections[i];
+            Section * t = &b->sections[i];
+            if(s->alloc != SECTION_MMAP || s->kind != SECTIONKIND_RODATA)
+                continue;
+            /* the same contents, wherever they came from */
+            if(s->size != t->size) abort();
+            if(0 != memcmp((void*)s->start, (void*)t->start, s->size)) abort();
+            size_t align = t->info->sectionHeader->sh_addralign;
+            if(align > 1 && 0 != (t->start & (align - 1))) abort();
+        }
+    }
+    if(a != NULL || b != NULL) abort();
+    if(copied.stats.readonly_file_mapped != 0) abort();
+    ___log("mapped from file: %lu bytes\n", mapped.stats.readonly_file_mapped);
+
+    if(resolvePending(&mapped)) abort();
+    int (*quad)(int) = (void*)lookupSymbol_(&mapped, "quad");
+    if(quad == NULL) abort();
+    ___log("quad: %d\n", quad(2));
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testNearCode(finder findFile) {
+    ___log("================================================================================\n");
+    ___log("Test: near code window\n");
+
+    char lib[128];  memset(lib, 0, sizeof lib);
+    if(findFile(lib, sizeof(lib), "lib", "a")) abort();
+
+    Linker anywhere = { .objects = NULL };
+    Linker near = { .objects = NULL, .loadFlags = LOAD_NEAR_CODE };
+    loadArchive(&anywhere, lib);
+    loadArchive(&near, lib);
+    if(near.code.window == 0x0 || near.code.window_overflows != 0) abort();
+
+    /* every loaded section is in the window */
+    for(ObjectCode *oc = near.objects; oc != NULL; oc = oc->next)
+        for(unsigned i = 0; i < oc->n_sections; i++) {
+            Section * s = &oc->sections[i];
+            if(s->alloc != SECTION_MMAP) continue;
+            if(s->start < near.code.window
+               || s->start + s->size > near.code.window + near.code.window_size)
+                abort();
+        }
+
+    if(resolvePending(&anywhere) || resolvePending(&near)) abort();
+    /* in the window, no stub space is reserved; veneers are shared */
+    if(near.stats.stubs_reserved != 0 || near.stats.stubs_made != 0) abort();
+    if(near.veneers.made > anywhere.stats.stubs_made) abort();
+    ___log("stubs made: %lu anywhere (of %lu reserved), "
+           "%lu veneers in the window\n",
+           anywhere.stats.stubs_made, anywhere.stats.stubs_reserved,
+           near.veneers.made);
+
+    int (*quad)(int) = (void*)lookupSymbol_(&near, "quad");
+    if(quad == NULL) abort();
+    ___log("quad: %d\n", quad(2));
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testStubs(finder f __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: stubs\n");
+
+    enum { N = 4096 };
+    size_t stub_size = STUB_GAP + STUB_SIZE * N;
+    void * mem = mmap(NULL, stub_size, PROT_READ | PROT_WRITE,
+                      MAP_ANON | MAP_PRIVATE, -1, 0);
+    if(mem == MAP_FAILED) abort();
+
+    SectionFormatInfo info = { .stub_offset = (addr_t)mem,
+                               .stub_size = stub_size };
+    Section section = { .info = &info };
+
+    /* targets that collide in the low bits */
+    for(addr_t t = 0; t < N; t++) {
+        addr_t addr = (t + 1) << 12;
+        if(!find_stub(&section, NULL, &addr)) abort(/* not made yet */);
+        if(make_stub(&section, NULL, &addr)) abort();
+        if(addr != (addr_t)mem + STUB_GAP + STUB_SIZE * t) abort();
+    }
+    if(info.nstubs != N) abort();
+    for(addr_t t = 0; t < N; t++) {
+        addr_t addr = (t + 1) << 12;
+        if(find_stub(&section, NULL, &addr)) abort();
+        if(addr != (addr_t)mem + STUB_GAP + STUB_SIZE * t) abort();
+    }
+    /* the stub space is full */
+    addr_t addr = (addr_t)(N + 1) << 12;
+    if(!make_stub(&section, NULL, &addr)) abort();
+
+    free_stubs(&section);
+    if(info.stubs != NULL || info.nstubs != 0) abort();
+    munmap(mem, stub_size);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+#if defined(__aarch64__)
+#define BRANCH_TO(sym) ELF64_R_INFO(sym, AARCH64_CALL26)
+#define DATA_TO(sym)   ELF64_R_INFO(sym, AARCH64_ABS64)
+#define PREL_TO(sym)   ELF64_R_INFO(sym, AARCH64_PREL32)
+#define RELOC_DESCRIPTORS   reloc_descriptors_arm64
+#define N_RELOC_DESCRIPTORS n_reloc_descriptors_arm64
+#else
+#define BRANCH_TO(sym) ELF32_R_INFO(sym, ARM_CALL)
+#define DATA_TO(sym)   ELF32_R_INFO(sym, ARM_ABS32)
+#define PREL_TO(sym)   ELF32_R_INFO(sym, ARM_REL32)
+#define RELOC_DESCRIPTORS   reloc_descriptors_arm
+#define N_RELOC_DESCRIPTORS n_reloc_descriptors_arm
+#endif
+
+bool
+testStubDemand(finder f __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: stub demand\n");
+
+    ElfSymbol symbols[4] = { { .name = NULL } };
+    ElfSymbolTable symtab = { .index = 1, .symbols = symbols, .n_symbols = 4 };
+    ElfShdr relaHeader = { .sh_link = 1 };
+    /* three branches to 1, one to 2, data to 3; and one beyond the table */
+    ElfRela relocations[] = {
+        { .r_info = BRANCH_TO(1) }, { .r_info = BRANCH_TO(2) },
+        { .r_info = BRANCH_TO(1) }, { .r_info = DATA_TO(3) },
+        { .r_info = BRANCH_TO(1) }, { .r_info = BRANCH_TO(9) },
+    };
+    ElfRelocationATable rela = { .targetSectionIndex = 2,
+                                 .sectionHeader = &relaHeader,
+                                 .relocations = relocations,
+                                 .n_relocations = 6 };
+    /* and one branch to 1 from another section */
+    ElfRelocationATable rela2 = { .targetSectionIndex = 3,
+                                  .sectionHeader = &relaHeader,
+                                  .relocations = relocations,
+                                  .n_relocations = 1 };
+    rela.next = &rela2;
+    ObjectCodeFormatInfo info = { .symbolTables = &symtab,
+                                  .relaTable = &rela };
+    ObjectCode oc = { .info = &info, .n_sections = 4 };
+
+    if(numberOfStubsForSection(&oc, 0) != 0) abort();
+    if(numberOfStubsForSection(&oc, 2) != 3) abort();
+    if(numberOfStubsForSection(&oc, 3) != 1) abort();
+    if(numberOfStubsForSection(&oc, 4) != 0) abort(/* no such section */);
+    free(info.stubDemand);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testDecodeRelocations(finder f __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: decoded relocations\n");
+
+    enum { N = 64 };
+    addr_t data[2 * N] = { 0 };
+    ElfSymbol symbols[3] = { { .name = NULL } };
+    symbols[1].addr = (addr_t)&data[0] + 0x1000;
+    symbols[2].addr = (addr_t)&data[0] - 0x2000;
+    ElfSymbolTable symtab = { .index = 1, .symbols = symbols, .n_symbols = 3 };
+    ElfShdr relaHeader = { .sh_link = 1 };
+
+    /* data and pc relative words, interleaved, and in reverse order */
+    ElfRela relocations[2 * N];
+    for(int i = 0; i < 2 * N; i++) {
+        int k = 2 * N - 1 - i;
+        relocations[i] = (ElfRela){
+                .r_offset = (addr_t)k * sizeof(addr_t),
+                .r_info = k % 2 ? PREL_TO(1 + k % 3 % 2) : DATA_TO(2),
+                .r_addend = k };
+    }
+    Section sections[2] = { { .kind = SECTIONKIND_OTHER },
+                            { .kind = SECTIONKIND_RWDATA,
+                              .start = (addr_t)data } };
+    ElfRelocationATable rela = { .targetSectionIndex = 1,
+                                 .sectionHeader = &relaHeader,
+                                 .symbolTable = &symtab,
+                                 .relocations = relocations,
+                                 .n_relocations = 2 * N };
+    ObjectCodeFormatInfo info = { .relaTable = &rela };
+    ObjectCode oc = { .info = &info, .sections = sections, .n_sections = 2 };
+
+    DecodedRelocations d;
+    if(decode_relocations(&oc, NULL, &d)) abort();
+    if(d.n != 2 * N || d.n_runs != 2) abort();
+    for(size_t r = 0; r < d.n_runs; r++) {
+        RelocRun * run = &d.runs[r];
+        if(run->end - run->start != N) abort();
+        for(size_t i = run->start + 1; i < run->end; i++)
+            if(d.P[i - 1] >= d.P[i]) abort(/* ordered by place */);
+        if(run->type == ELF_R_TYPE(DATA_TO(0)))
+            reloc_abs(&d, run);
+        else if(reloc_prel32(&d, run))
+            abort();
+    }
+    for(int k = 0; k < 2 * N; k++) {
+        addr_t P = (addr_t)&data[k];
+        if(k % 2) {
+            uint32_t w;
+            memcpy(&w, &data[k], sizeof(w));
+            if(w != (uint32_t)(symbols[1 + k % 3 % 2].addr + k - P)) abort();
+        } else if(data[k] != symbols[2].addr + k) {
+            abort();
+        }
+    }
+    free_decoded_relocations(&d);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testRelocDescriptors(finder f __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: relocation descriptors\n");
+
+    for(size_t type = 0; type < N_RELOC_DESCRIPTORS; type++) {
+        RelocDescriptor D = RELOC_DESCRIPTORS[type];
+        if(D.formula == RELOC_NONE)
+            continue;
+        uint64_t mask = D.fields[0].mask | D.fields[1].mask;
+        if(D.fields[0].mask & D.fields[1].mask) abort(/* overlap */);
+        if(D.width < 8 && (mask & ((UINT64_C(1) << (8 * D.width)) - 1)) == 0)
+            abort(/* no field in the place */);
+
+        /* values in range go into the fields and come out alike; the bits
+         * outside the fields are kept */
+        addr_t values[] = { 0, 1, 0x7ff, 0x1000, 0x123456, -0x1000, -1 };
+        for(size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+            addr_t V = values[i] & ~(((addr_t)1 << D.align) - 1);
+            if(D.formula == RELOC_S_A_LO12)
+                V &= 0xfff;
+            else if(D.formula == RELOC_PAGE_S_A_P)
+                V = RELOC_PAGE(V);
+            uint64_t place = UINT64_C(0x5a5a5a5a5a5a5a5a);
+            reloc_encode(D, (addr_t)&place, V);
+            if(reloc_check(D, V) != 0) {
+                continue; /* out of range for the type */
+            }
+            uint64_t keep = ~mask & (D.width < 8
+                                     ? (UINT64_C(1) << (8 * D.width)) - 1
+                                     : ~UINT64_C(0));
+            if((place & keep) != (UINT64_C(0x5a5a5a5a5a5a5a5a) & keep))
+                abort();
+            /* the fields drop the bits below their shift, and lo12 is not
+             * sign extended */
+            addr_t low = ((addr_t)1 << D.fields[0].shr) - 1;
+            addr_t back = reloc_decode(D, (addr_t)&place);
+            if(D.formula == RELOC_S_A_LO12)
+                back &= 0xfff;
+            if(D.width < sizeof(addr_t)) {
+                back &= ((addr_t)1 << (8 * D.width)) - 1;
+                V    &= ((addr_t)1 << (8 * D.width)) - 1;
+            }
+            if(back != (V & ~low)) abort();
+        }
+    }
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+bool
+testVeneers(finder f __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: shared veneers\n");
+
+    Linker l = { .objects = NULL };
+    if(code_arena_reserve(&l.code, false, NULL)) abort();
+    addr_t P = l.code.window + 4096;
+    addr_t Q = l.code.window + l.code.window_size - 4096;
+    addr_t far = l.code.window + 4 * BRANCH_RANGE;
+
+    /* one veneer serves every branch in range */
+    addr_t a = far, b = far;
+    if(!find_veneer(&l.veneers, P, BRANCH_RANGE, far, &a))
+        abort(/* none yet */);
+    if(make_veneer(&l.veneers, &l.code, P, BRANCH_RANGE, far, &a)) abort();
+    if(find_veneer(&l.veneers, Q, BRANCH_RANGE, far, &b) || a != b) abort();
+    if(l.veneers.made != 1 || l.veneers.shared != 1) abort();
+
+    /* ... of its own kind; a shorter branch at the far end is not */
+    if(!find_veneer(&l.veneers, Q, (addr_t)1 << 20, far, &b)) abort();
+
+    /* other targets get veneers of their own, in the same island */
+    for(addr_t t = 1; t <= 1000; t++) {
+        addr_t c = far + t * 16;
+        if(make_veneer(&l.veneers, &l.code, P, BRANCH_RANGE, far + t * 16,
+                       &c)) abort();
+        if(c != a + t * STUB_SIZE) abort();
+    }
+    seal_veneers(&l.veneers);
+    if(l.veneers.islands->sealed != l.veneers.islands->used) abort();
+
+    /* nothing is added to a sealed page */
+    addr_t d = far - 16;
+    if(make_veneer(&l.veneers, &l.code, P, BRANCH_RANGE, far - 16, &d)) abort();
+    if(d < l.veneers.islands->start + l.veneers.islands->sealed
+       && d >= l.veneers.islands->start)
+        abort();
+
+    free_veneers(&l.veneers);
+    code_arena_free(&l.code);
+
+    /* near the host: the window ends where the anchor's object begins, if
+     * that address space is free */
+    Dl_info info;
+    if(0 == dladdr((void*)&testVeneers, &info)) abort();
+    code_arena host = { .window = 0x0 };
+    if(code_arena_reserve(&host, true, (void*)&testVeneers)) abort();
+    if(host.window_near
+       && host.window + host.window_size != (addr_t)info.dli_fbase)
+        abort();
+    ___log("window %p near %s: %s\n", (void*)host.window, info.dli_fname,
+           host.window_near ? "yes" : "no");
+    code_arena_free(&host);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+/* the bytes of an object's segments and GOT, back to back */
+static uint8_t *
+snapshot_object(ObjectCode * oc, size_t * size) {
+    ObjectCodeFormatInfo * info = oc->info;
+    *size = info->got_size;
+    for(int k = 0; k < N_SEGMENTS; k++)
+        *size += info->segments[k].size;
+    uint8_t * bytes = malloc(*size + 1), * p = bytes;
+    if(bytes == NULL) abort();
+    for(int k = 0; k < N_SEGMENTS; k++) {
+        memcpy(p, (void*)info->segments[k].start, info->segments[k].size);
+        p += info->segments[k].size;
+    }
+    if(info->got_size > 0)
+        memcpy(p, (void*)info->got_start, info->got_size);
+    return bytes;
+}
+
+/* back to as loaded, from a snapshot taken before resolving */
+static void
+restore_object(ObjectCode * oc, const uint8_t * bytes) {
+    ObjectCodeFormatInfo * info = oc->info;
+    for(int k = 0; k < N_SEGMENTS; k++) {
+        Segment * s = &info->segments[k];
+        if(s->size == 0) continue;
+        if(!s->rwx && mprotect((void*)s->start, s->size,
+                               PROT_READ | PROT_WRITE)) abort();
+        memcpy((void*)s->start, bytes, s->size);
+        bytes += s->size;
+    }
+    if(info->got_size > 0) {
+        if(mprotect((void*)info->got_start, info->got_size,
+                    PROT_READ | PROT_WRITE)) abort();
+        memcpy((void*)info->got_start, bytes, info->got_size);
+    }
+    for(unsigned i = 0; i < oc->n_sections; i++)
+        free_stubs(&oc->sections[i]);
+    oc->status = OBJECT_LOADED;
+}
+
+/* the bytes of all veneers made, island by island */
+static uint8_t *
+snapshot_veneers(Veneers * v, size_t * size) {
+    *size = 0;
+    for(VeneerIsland * i = v->islands; i != NULL; i = i->next)
+        *size += i->used;
+    uint8_t * bytes = malloc(*size + 1), * p = bytes;
+    if(bytes == NULL) abort();
+    for(VeneerIsland * i = v->islands; i != NULL; i = i->next) {
+        memcpy(p, (void*)i->start, i->used);
+        p += i->used;
+    }
+    return bytes;
+}
+
+/* an object whose function far_call calls __link_far_target */
+static uint8_t *
+make_far_call_object(size_t * image_size) {
+    static const char strtab[] = "\0far_call\0__link_far_target";
+    ElfSym syms[] = {
+            { .st_name = 1, .st_info = (STB_GLOBAL << 4) | STT_FUNC,
+              .st_shndx = BENCH_TEXT, .st_size = 8 },
+            { .st_name = 10, .st_info = (STB_GLOBAL << 4) | STT_NOTYPE,
+              .st_shndx = SHN_UNDEF },
+    };
+#if defined(__aarch64__)
+    ElfRela rel = { .r_offset = 0, .r_info = ELF_R_INFO(2, AARCH64_CALL26) };
+    const uint32_t call = 0x94000000;
+#else
+    ElfRel rel = { .r_offset = 0, .r_info = ELF_R_INFO(2, ARM_CALL) };
+    const uint32_t call = 0xebfffffe;
+#endif
+    bench_object o = { .text_size = 8, .syms = syms, .nsyms = 2,
+                       .strtab = strtab, .strtab_size = sizeof(strtab),
+                       .rels = &rel, .nrels = 1, .rel_section = BENCH_TEXT };
+    uint8_t * text = NULL;
+    uint8_t * image = make_object(&o, &text, image_size);
+    const uint32_t ret = BENCH_RET;
+    memcpy(text, &call, sizeof(call));
+    memcpy(text + 4, &ret, sizeof(ret));
+    return image;
+}
+
+bool
+testResolveAll(finder findFile) {
+    ___log("================================================================================\n");
+    ___log("Test: parallel resolve\n");
+
+    char lib[128];  memset(lib, 0, sizeof lib);
+    if(findFile(lib, sizeof(lib), "lib", "a")) abort();
+
+    /* in the window, no stub space is reserved: a call out of it is
+     * deferred by the local pass, and goes through a veneer */
+    Linker l = { .objects = NULL, .loadFlags = LOAD_NEAR_CODE };
+    loadArchive(&l, lib);
+    size_t image_size = 0;
+    uint8_t * image = make_far_call_object(&image_size);
+    if(NULL == loadObjectFromMemory(&l, "far_call.o", image, image_size,
+                                    IMAGE_ADOPT))
+        abort();
+    ElfSymbol target = { .name = "__link_far_target",
+                         .addr = l.code.window + 4 * BRANCH_RANGE };
+    GlobalSymbol global = { .symbol = &target };
+    if(!insert_global_symbol(&l, &global)) abort();
+    size_t window_used = l.code.window_used;
+
+    size_t n = 0;
+    for(ObjectCode *oc = l.objects; oc != NULL; oc = oc->next)
+        n++;
+    uint8_t ** loaded = calloc(n, sizeof(uint8_t *));
+    uint8_t ** serial = calloc(n, sizeof(uint8_t *));
+    size_t * sizes = calloc(n, sizeof(size_t));
+    if(loaded == NULL || serial == NULL || sizes == NULL) abort();
+    size_t i = 0;
+    for(ObjectCode *oc = l.objects; oc != NULL; oc = oc->next, i++)
+        loaded[i] = snapshot_object(oc, &sizes[i]);
+
+    /* the same objects, at the same addresses, on one thread and on eight */
+    if(resolveAll(&l, 1)) abort();
+    unsigned long made = l.veneers.made;
+    if(made == 0) abort(/* the far call was not deferred */);
+    size_t veneers_size = 0;
+    uint8_t * veneers = snapshot_veneers(&l.veneers, &veneers_size);
+    i = 0;
+    for(ObjectCode *oc = l.objects; oc != NULL; oc = oc->next, i++) {
+        if(oc->status != OBJECT_RESOLVED) abort();
+        serial[i] = snapshot_object(oc, &sizes[i]);
+        restore_object(oc, loaded[i]);
+    }
+    /* nothing made by the first pass is reused; its islands are taken from
+     * the window again, at the same addresses */
+    free_veneers(&l.veneers);
+    memset(&l.veneers, 0, sizeof(l.veneers));
+    l.code.window_used = window_used;
+
+    if(resolveAll(&l, 8)) abort();
+    if(l.veneers.made != made) abort();
+    size_t size = 0;
+    uint8_t * parallel = snapshot_veneers(&l.veneers, &size);
+    if(size != veneers_size || 0 != memcmp(parallel, veneers, size)) abort();
+    free(parallel);
+    free(veneers);
+    i = 0;
+    for(ObjectCode *oc = l.objects; oc != NULL; oc = oc->next, i++) {
+        parallel = snapshot_object(oc, &size);
+        if(oc->status != OBJECT_RESOLVED) abort();
+        if(size != sizes[i] || 0 != memcmp(parallel, serial[i], size)) abort();
+        free(parallel);
+        free(serial[i]);
+        free(loaded[i]);
+    }
+    free(sizes);
+    free(serial);
+    free(loaded);
+
+    int (*quad)(int) = (void*)lookupSymbol_(&l, "quad");
+    if(quad == NULL) abort();
+    ___log("quad: %d (%lu objects, %lu veneers)\n", quad(2), (unsigned long)n,
+           made);
+    linkerFree(&l);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
+
+typedef struct _drained { unsigned n; char last[LINK_LOG_MESSAGE_SIZE]; } drained;
+
+static void
+collect_message(const char * message, void * ctx) {
+    drained * d = ctx;
+    d->n++;
+    snprintf(d->last, sizeof(d->last), "%s", message);
+}
+
+static int
+evaluated(int * count) {
+    return ++*count;
+}
+
+bool
+testLog(finder f __attribute__((unused))) {
+    ___log("================================================================================\n");
+    ___log("Test: leveled logging\n");
+
+    drained d = { 0 };
+    link_log_drain(collect_message, &d); /* whatever was there */
+    d.n = 0;
+
+    link_log_to(false, true);
+    link_log_configure(LINK_LOG_WARN, LINK_LOG_STUB);
+
+    int count = 0;
+    link_log(LINK_LOG_WARN, LINK_LOG_STUB, "stub %d\n", evaluated(&count));
+    link_log(LINK_LOG_WARN, LINK_LOG_RELOC, "reloc %d\n", evaluated(&count));
+    link_log(LINK_LOG_INFO, LINK_LOG_STUB, "info %d\n", evaluated(&count));
+    link_log(LINK_LOG_ERROR, LINK_LOG_RELOC, "error %d\n", evaluated(&count));
+    /* filtered messages don't evaluate their arguments */
+    if(count != 2) abort();
+    if(link_log_drain(collect_message, &d) != 2 || d.n != 2) abort();
+    if(0 != strcmp(d.last, "error 2\n")) abort();
+
+    /* the ring keeps the last messages only */
+    for(int i = 0; i < 3 * LINK_LOG_RING_SIZE; i++)
+        link_log(LINK_LOG_WARN, LINK_LOG_STUB, "warn %d\n", i);
+    d.n = 0;
+    if(link_log_drain(collect_message, &d) != LINK_LOG_RING_SIZE) abort();
+    char expect[32];
+    snprintf(expect, sizeof(expect), "warn %d\n", 3 * LINK_LOG_RING_SIZE - 1);
+    if(0 != strcmp(d.last, expect)) abort();
+    if(link_log_drain(collect_message, &d) != 0) abort();
+
+    link_log_configure(LINK_LOG_INFO, LINK_LOG_ALL);
+    link_log_to(true, false);
+
+    ___log("================================================================================\n");
+    return EXIT_SUCCESS;
+}
@@ -11,5 +11,25 @@ bool  testGlobalReloc(finder f);
 bool  testArchive(finder f);
 bool  testRelocCounter(finder f);
 bool  testLoadHS(finder f);
+bool  testSymbolTable(finder f);
+bool  testHash(finder f);
+bool  testSystemSymbolCache(finder f);
+bool  testDynamicSymbols(finder f);
+bool  testIntern(finder f);
+bool  testSymbolIndex(finder f);
+bool  testConcurrentLookup(finder f);
+bool  testParallelArchive(finder f);
+bool  testAddressIndex(finder f);
+bool  testLoadFromMemory(finder f);
+bool  testSectionLayout(finder f);
+bool  testFileBackedRodata(finder f);
+bool  testNearCode(finder f);
+bool  testStubs(finder f);
+bool  testStubDemand(finder f);
+bool  testDecodeRelocations(finder f);
+bool  testRelocDescriptors(finder f);
+bool  testVeneers(finder f);
+bool  testResolveAll(finder f);
+bool  testLog(finder f);
 
 #endif //LINK_TESTS_H
@@ -13,6 +13,7 @@ typedef void * SymbolAddr;
 typedef enum _OStatus {
     OBJECT_LOADED,
     OBJECT_NEEDED,
+    OBJECT_RESOLVING,  /* claimed by resolveAll */
     OBJECT_RESOLVED,
     OBJECT_UNLOADED,
     OBJECT_DONT_RESOLVE
@@ -38,7 +39,8 @@ typedef enum _SectionAlloc {
 typedef struct _ElfSymbol {
     SymbolName * name;  /* the name of the symbol. */
     addr_t addr;  /* the final resting place of the symbol */
-    hash_t hash;
+    hash_t hash;  /* only meaningful if hash_valid; see symbol_hash */
+    bool hash_valid;
     addr_t got_addr;    /* address of the got slot for this symbol, if any */
     ElfSym * elf_sym;  /* the elf symbol entry */
 } ElfSymbol;
@@ -51,10 +53,19 @@ typedef struct _ElfSymbolTable {
     struct _ElfSymbolTable * next; /* there may be multiple symbol tables */
 } ElfSymbolTable;
 
+/* a sized symbol's address range; see ObjectCodeFormatInfo.symbolsByAddr */
+typedef struct _SymbolRange {
+    addr_t start;
+    size_t size;
+    addr_t reach;  /* the largest end of this and all prior ranges */
+    ElfSymbol * symbol;
+} SymbolRange;
+
 typedef struct _ElfRelocationTable {
     unsigned index;
     unsigned targetSectionIndex;
     ElfShdr *sectionHeader;
+    ElfSymbolTable *symbolTable; /* sh_link; bound by ocInit */
     ElfRel  *relocations;
     size_t n_relocations;
     struct _ElfRelocationTable *next;
@@ -64,6 +75,7 @@ typedef struct _ElfRelocationATable {
     unsigned index;
     unsigned targetSectionIndex;
     ElfShdr *sectionHeader;
+    ElfSymbolTable *symbolTable; /* sh_link; bound by ocInit */
     ElfRela  *relocations;
     size_t n_relocations;
     struct _ElfRelocationATable *next;
@@ -72,7 +84,6 @@ typedef struct _ElfRelocationATable {
 typedef struct _Stub {
     addr_t addr;
     addr_t target;
-    struct _Stub * next;
 } Stub;
 
 typedef struct _SectionFormatInfo {
@@ -82,7 +93,12 @@ typedef struct _SectionFormatInfo {
     addr_t stub_offset;
     size_t stub_size;
     size_t nstubs;
+    /* the stubs made, in order; room for all stub_size has space for */
     Stub * stubs;
+    /* open addressing map, target -> 1 + index into stubs (0 if free), of
+     * stub_map_mask + 1 slots; allocated along with stubs */
+    uint32_t * stub_map;
+    size_t stub_map_mask;
 
     char * name;
 
@@ -105,6 +121,24 @@ typedef struct _Section {
     SectionFormatInfo* info;
 } Section;
 
+/*
+ * An object's loaded sections are packed into one segment per protection
+ * class; see load_sections.
+ */
+typedef enum _SegmentKind {
+    SEGMENT_TEXT,   /* text and stubs (rx) */
+    SEGMENT_RODATA, /* (r), after relocation */
+    SEGMENT_RWDATA, /* data and bss (rw) */
+    N_SEGMENTS
+} SegmentKind;
+
+typedef struct _Segment {
+    addr_t start;  /* page aligned */
+    size_t size;   /* a multiple of the page size; 0 if empty */
+    int    prot;   /* final protection */
+    bool   rwx;    /* in a MAP_HUGETLB region; never mprotect'ed */
+} Segment;
+
 /*
  * Just a quick ELF recap:
  *
@@ -139,6 +173,31 @@ typedef struct _ObjectCodeFormatInfo {
     ElfRelocationTable   *relTable;
     ElfRelocationATable  *relaTable;
 
+    /* defined symbols with a size, sorted by address (ties in symbol table
+     * order); built by get_names, for symbolization */
+    SymbolRange          *symbolsByAddr;
+    size_t                n_symbolsByAddr;
+
+    /* per section, the distinct targets of branches that may need a stub;
+     * counted in one pass over all relocation tables, see
+     * numberOfStubsForSection */
+    unsigned             *stubDemand;
+
+    /* relocations left for the serial pass of resolveAll; see
+     * relocate_object_code_local */
+    struct _DecodedRelocations *deferred;
+
+    /* the tables above, and the names that are not interned, copied out of
+     * the image when it is released (see release_image) */
+    void                 *tables;
+
+    /* the single mapping holding all segments; but for the text segment,
+     * with LOAD_HUGE_TEXT (see CodeArena.h) */
+    addr_t                mapping;
+    size_t                mapping_size;
+    Segment               segments[N_SEGMENTS];
+    /* bytes of read only sections mapped from the file, not copied */
+    size_t                file_mapped;
 
     /* pointer to the global offset table */
     addr_t                got_start;
@@ -146,6 +205,29 @@ typedef struct _ObjectCodeFormatInfo {
 
 } ObjectCodeFormatInfo;
 
+/* options for loading an object's sections; see Linker.loadFlags */
+typedef enum _LoadFlags {
+    /* map large read only sections from the object file (MAP_PRIVATE),
+     * rather than copying them; the file must not change while loaded. */
+    LOAD_MAP_READONLY = 1 << 0,
+    /* place text and stubs in huge page regions; see CodeArena.h */
+    LOAD_HUGE_TEXT    = 1 << 1,
+    /* ... trying MAP_HUGETLB first; implies LOAD_HUGE_TEXT */
+    LOAD_HUGETLB_TEXT = 1 << 2,
+    /* allocate all segments from a reserved window, such that branches
+     * within the session need no stubs; see CodeArena.h */
+    LOAD_NEAR_CODE    = 1 << 3,
+    /* ... placed near the host; implies LOAD_NEAR_CODE */
+    LOAD_NEAR_HOST    = 1 << 4,
+} LoadFlags;
+
+/* how loadObjectFromMemory treats the embedder's image */
+typedef enum _ImageOwnership {
+    IMAGE_BORROW, /* the embedder keeps it until loadObjectFromMemory returns */
+    IMAGE_ADOPT,  /* liblink takes over the (malloc'd) image */
+    IMAGE_COPY    /* liblink copies it; the embedder may release it right away */
+} ImageOwnership;
+
 typedef struct _ProddableBlock {
     void* start;
     int   size;
@@ -162,6 +244,8 @@ typedef struct _ObjectCode {
      * like "libarchive.a(object.o)". Otherwise it's NULL.
      */
     char*      archiveMemberName;
+    /* ... and the offset of its contents in the archive file */
+    long       archiveMemberOffset;
 
     /* An array containing ptrs to all the symbol names copied from
        this object into the global symbol hash table.  This is so that
@@ -170,7 +254,8 @@ typedef struct _ObjectCode {
     char**  symbols;
     unsigned n_symbols;
 
-    /* ptr to mem containing the object file image */
+    /* ptr to mem containing the object file image; its tables are used in
+     * place until the object is published, NULL once released */
     uint8_t *      image;
 
     /* A customizable type, that formats can use to augment ObjectCode */
@@ -179,6 +264,14 @@ typedef struct _ObjectCode {
     /* non-zero if the object file was mmap'd, otherwise malloc'd */
     bool        imageMapped;
 
+    /* LoadFlags, as set for the linker session at load time */
+    unsigned    loadFlags;
+
+    /* the image was handed in by the embedder (loadObjectFromMemory), and
+     * not read from fileName; it belongs to the embedder if borrowed. */
+    bool        imageFromMemory;
+    bool        imageBorrowed;
+
     /* flag used when deciding whether to unload an object file */
     bool        referenced;
 
@@ -4,43 +4,28 @@
 
 #include "debug.h"
 
-void __link_log(const char *fmt, ...)
-{
-    va_list ap;
-    va_start(ap, fmt);
-#if defined(__ANDROID__)
-    __android_log_vprint(ANDROID_LOG_FATAL, "SERV", fmt, ap);
-#else
-    vprintf(fmt, ap);
-#endif
-    va_end(ap);
-}
-
 ObjectCode *
 find_oc_for_GOT_addr(Linker *l, addr_t got_addr) {
-    for(ObjectCode * oc = l->objects; oc != NULL; oc = oc->next)
-        if (oc->info->got_size > 0
-            && oc->info->got_start <=  got_addr
-            && got_addr < oc->info->got_start + oc->info->got_size)
-            return oc;
-    return NULL;
+    addr_range r;
+    if(addr_index_lookup(&l->ranges, got_addr, &r) || r.section != NULL)
+        return NULL;
+    return r.oc;
 }
 
 OcInfo
 find_section(Linker * l, addr_t addr ) {
-    OcInfo r = { .oc = NULL, .section = NULL };
-    for(ObjectCode * oc = l->objects; oc != NULL; oc = oc->next) {
-        for(size_t i=0; i < oc->n_sections; i++) {
-            if(oc->sections[i].start <= addr &&
-               addr < oc->sections[i].start + oc->sections[i].size) {
-                r.oc = oc; r.section = &oc->sections[i];
-                return r;
-            }
-        }
+    OcInfo info = { .oc = NULL, .section = NULL };
+    addr_range r;
+    if(!addr_index_lookup(&l->ranges, addr, &r) && r.section != NULL) {
+        info.oc = r.oc; info.section = r.section;
     }
-    return r;
+    return info;
 }
 
+/*
+ * Neither allocates nor locks; safe to use from a signal handler (once the
+ * calling thread has entered an epoch before, see Epoch.h).
+ */
 ElfSymbol *
 find_near_symbol(Linker * l, addr_t addr) {
     OcInfo info = find_section(l, addr);
@@ -50,15 +35,24 @@ find_near_symbol(Linker * l, addr_t addr) {
     if(oc == NULL)
         return NULL;
 
-    for(ElfSymbolTable * stab=oc->info->symbolTables;
-        stab != NULL; stab = stab->next) {
-        for(unsigned i = 0; i < stab->n_symbols; i++) {
-            ElfSymbol * s = &stab->symbols[i];
-            if(s->elf_sym->st_size == 0) continue;
-
-            if(s->addr <= addr
-                && (addr < s->addr + s->elf_sym->st_size))
-                return s;
+    /* the symbols starting at or before addr */
+    SymbolRange * r = oc->info->symbolsByAddr;
+    size_t lo = 0, hi = oc->info->n_symbolsByAddr;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(r[mid].start <= addr) lo = mid + 1;
+        else hi = mid;
+    }
+    /* the innermost one enclosing addr; an enclosing symbol starting
+     * earlier reaches past the ones in between */
+    for(size_t i = lo; i > 0 && addr < r[i - 1].reach; i--) {
+        if(addr < r[i - 1].start + r[i - 1].size) {
+            /* of aliases, the first in symbol table order */
+            size_t k = i - 1;
+            while(k > 0 && r[k - 1].start == r[k].start
+                  && addr < r[k - 1].start + r[k - 1].size)
+                k--;
+            return r[k].symbol;
         }
     }
     return NULL;
@@ -66,15 +60,17 @@ find_near_symbol(Linker * l, addr_t addr) {
 
 ElfSymbol *
 find_symbol_by_GOT_addr(Linker * l, addr_t got_addr) {
-    for(ObjectCode *oc=l->objects; oc != NULL; oc = oc->next) {
-        for (ElfSymbolTable *stab = oc->info->symbolTables;
-             stab != NULL; stab = stab->next) {
-            for (unsigned i = 0; i < stab->n_symbols; i++) {
-                ElfSymbol *s = &stab->symbols[i];
-                if (s->elf_sym->st_size == 0) continue;
-                if (s->got_addr == got_addr)
-                    return s;
-            }
+    /* only the GOT's owner can have a symbol with that slot */
+    ObjectCode * oc = find_oc_for_GOT_addr(l, got_addr);
+    if(oc == NULL)
+        return NULL;
+    for (ElfSymbolTable *stab = oc->info->symbolTables;
+         stab != NULL; stab = stab->next) {
+        for (unsigned i = 0; i < stab->n_symbols; i++) {
+            ElfSymbol *s = &stab->symbols[i];
+            if (s->elf_sym->st_size == 0) continue;
+            if (s->got_addr == got_addr)
+                return s;
         }
     }
     return NULL;
@@ -2,8 +2,7 @@
 #define LINK_DEBUG_H
 
 #include "Linker.h"
-
-void __link_log(const char *fmt, ...);
+#include "Log.h"
 
 typedef struct _OcInfo { ObjectCode * oc; Section * section; } OcInfo;
 
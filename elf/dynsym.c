@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <link.h>
+#include "dynsym.h"
+#include "../debug.h"
+
+/* bits per bloom filter word; ElfAddr sized */
+#define BLOOM_BITS (8 * sizeof(ElfAddr))
+
+/* hidden symbol versions are not visible to dlsym either */
+#define VERSYM_HIDDEN 0x8000
+
+uint32_t
+gnu_hash(const char * name) {
+    uint32_t h = 5381;
+    for(const uint8_t * p = (const uint8_t *)name; *p != '\0'; p++)
+        h = (h << 5) + h + *p;
+    return h;
+}
+
+static const char *
+base_name(const char * path) {
+    const char * s = strrchr(path, '/');
+    return s == NULL ? path : s + 1;
+}
+
+bool
+dynamic_objects_register(DynamicObjects * d, const char * name) {
+    char ** wanted = realloc(d->wanted, (d->n_wanted + 1) * sizeof(char *));
+    if(wanted == NULL)
+        return EXIT_FAILURE;
+    d->wanted = wanted;
+    d->wanted[d->n_wanted] = strdup(base_name(name));
+    assert(d->wanted[d->n_wanted] != NULL);
+    d->n_wanted++;
+    d->stale = true;
+    return EXIT_SUCCESS;
+}
+
+static bool
+is_wanted(DynamicObjects * d, const char * name) {
+    if(name == NULL || *name == '\0')
+        return false;
+    const char * base = base_name(name);
+    for(size_t i = 0; i < d->n_wanted; i++)
+        if(0 == strcmp(d->wanted[i], base))
+            return true;
+    return false;
+}
+
+/*
+ * Dynamic entries hold addresses; most loaders relocate them in place, some
+ * (bionic) do not.  Anything below the load bias can't be an address in the
+ * object.
+ */
+static addr_t
+dyn_ptr(addr_t base, ElfAddr ptr) {
+    return (addr_t)ptr < base ? base + (addr_t)ptr : (addr_t)ptr;
+}
+
+/* every object, registered or not; see DynamicObject.wanted */
+static int
+collect_object(struct dl_phdr_info * info, size_t size __attribute__((unused)),
+               void * ctx) {
+    DynamicObjects * d = ctx;
+    DynamicObject o = { 0 };
+    o.wanted = is_wanted(d, info->dlpi_name);
+    o.base = (addr_t)info->dlpi_addr;
+
+    ElfDyn * dyn = NULL;
+    for(unsigned i = 0; i < info->dlpi_phnum; i++)
+        if(info->dlpi_phdr[i].p_type == PT_DYNAMIC)
+            dyn = (ElfDyn *)(o.base + info->dlpi_phdr[i].p_vaddr);
+    /* statically linked; nothing to look up (nor to interpose) */
+    if(dyn == NULL)
+        return 0;
+
+    uint32_t * gnu_hash_table = NULL;
+    for(; dyn->d_tag != DT_NULL; dyn++) {
+        switch(dyn->d_tag) {
+            case DT_GNU_HASH:
+                gnu_hash_table = (uint32_t *)dyn_ptr(o.base, dyn->d_un.d_ptr);
+                break;
+            case DT_HASH:
+                o.sysv_hash = (uint32_t *)dyn_ptr(o.base, dyn->d_un.d_ptr);
+                break;
+            case DT_SYMTAB:
+                o.symtab = (ElfSym *)dyn_ptr(o.base, dyn->d_un.d_ptr);
+                break;
+            case DT_STRTAB:
+                o.strtab = (char *)dyn_ptr(o.base, dyn->d_un.d_ptr);
+                break;
+            case DT_VERSYM:
+                o.versym = (ElfHalf *)dyn_ptr(o.base, dyn->d_un.d_ptr);
+                break;
+            default:
+                break;
+        }
+    }
+    /* kept, such that lookups defer to dlsym when they get here */
+    if(o.symtab == NULL || o.strtab == NULL)
+        o.sysv_hash = gnu_hash_table = NULL;
+
+    if(gnu_hash_table != NULL) {
+        o.nbuckets    = gnu_hash_table[0];
+        o.symoffset   = gnu_hash_table[1];
+        o.bloom_size  = gnu_hash_table[2];
+        o.bloom_shift = gnu_hash_table[3];
+        o.bloom       = (ElfAddr *)&gnu_hash_table[4];
+        o.buckets     = (uint32_t *)&o.bloom[o.bloom_size];
+        o.chain       = &o.buckets[o.nbuckets];
+    } /* else: the SysV .hash, or we'll have to defer to dlsym */
+
+    o.name = strdup(info->dlpi_name != NULL ? info->dlpi_name : "");
+    assert(o.name != NULL);
+
+    DynamicObject * objects = realloc(d->objects,
+                                      (d->n_objects + 1) * sizeof(DynamicObject));
+    assert(objects != NULL);
+    d->objects = objects;
+    d->objects[d->n_objects++] = o;
+    return 0;
+}
+
+static void
+free_objects(DynamicObjects * d) {
+    for(size_t i = 0; i < d->n_objects; i++)
+        free(d->objects[i].name);
+    free(d->objects);
+    d->objects = NULL;
+    d->n_objects = 0;
+}
+
+void
+dynamic_objects_free(DynamicObjects * d) {
+    free_objects(d);
+    for(size_t i = 0; i < d->n_wanted; i++)
+        free(d->wanted[i]);
+    free(d->wanted);
+    d->wanted = NULL;
+    d->n_wanted = 0;
+    d->stale = false;
+}
+
+/* the symbol i of o, if it is a visible definition of name */
+static DynLookup
+match(DynamicObject * o, uint32_t i, const char * name, addr_t * addr) {
+    ElfSym * s = &o->symtab[i];
+    if(0 != strcmp(name, o->strtab + s->st_name)
+       || s->st_shndx == SHN_UNDEF
+       || (o->versym != NULL && 0 != (o->versym[i] & VERSYM_HIDDEN)))
+        return DYNSYM_NOT_FOUND;
+    switch(ELF_ST_TYPE(s->st_info)) {
+        case STT_TLS:
+        case STT_GNU_IFUNC:
+            return DYNSYM_UNKNOWN;
+        default:
+            break;
+    }
+    switch(ELF_ST_BIND(s->st_info)) {
+        case STB_GLOBAL:
+        case STB_WEAK:
+            *addr = o->base + s->st_value;
+            return DYNSYM_FOUND;
+        default:
+            return DYNSYM_NOT_FOUND;
+    }
+}
+
+static uint32_t
+sysv_hash(const char * name) {
+    uint32_t h = 0;
+    for(const uint8_t * p = (const uint8_t *)name; *p != '\0'; p++) {
+        h = (h << 4) + *p;
+        uint32_t g = h & 0xf0000000;
+        if(g != 0)
+            h ^= g >> 24;
+        h &= ~g;
+    }
+    return h;
+}
+
+/* the slow path, for objects without .gnu.hash: no bloom filter, and the
+ * chains hold no hashes */
+static DynLookup
+lookup_sysv(DynamicObject * o, const char * name, addr_t * addr) {
+    uint32_t nbucket = o->sysv_hash[0], nchain = o->sysv_hash[1];
+    const uint32_t * bucket = &o->sysv_hash[2];
+    const uint32_t * chain  = &bucket[nbucket];
+    if(nbucket == 0)
+        return DYNSYM_NOT_FOUND;
+    for(uint32_t i = bucket[sysv_hash(name) % nbucket];
+        i != STN_UNDEF && i < nchain; i = chain[i]) {
+        DynLookup r = match(o, i, name, addr);
+        if(r != DYNSYM_NOT_FOUND)
+            return r;
+    }
+    return DYNSYM_NOT_FOUND;
+}
+
+static DynLookup
+lookup_in(DynamicObject * o, const char * name, uint32_t h1, addr_t * addr) {
+    if(o->nbuckets == 0)
+        return o->sysv_hash != NULL ? lookup_sysv(o, name, addr)
+                                    : DYNSYM_UNKNOWN;
+
+    ElfAddr word = o->bloom[(h1 / BLOOM_BITS) % o->bloom_size];
+    ElfAddr mask = ((ElfAddr)1 << (h1 % BLOOM_BITS))
+                 | ((ElfAddr)1 << ((h1 >> o->bloom_shift) % BLOOM_BITS));
+    if((word & mask) != mask)
+        return DYNSYM_NOT_FOUND;
+
+    uint32_t i = o->buckets[h1 % o->nbuckets];
+    if(i < o->symoffset)
+        return DYNSYM_NOT_FOUND;
+
+    for(;; i++) {
+        uint32_t h2 = o->chain[i - o->symoffset];
+        if((h1 | 1) == (h2 | 1)) {
+            DynLookup r = match(o, i, name, addr);
+            if(r != DYNSYM_NOT_FOUND)
+                return r;
+        }
+        if(h2 & 1)
+            break;
+    }
+    return DYNSYM_NOT_FOUND;
+}
+
+DynLookup
+dynamic_objects_lookup(DynamicObjects * d, const char * name, addr_t * addr) {
+    if(d->n_wanted == 0)
+        return DYNSYM_UNKNOWN;
+
+    if(d->stale) {
+        free_objects(d);
+        dl_iterate_phdr(collect_object, d);
+        d->stale = false;
+        size_t wanted = 0;
+        for(size_t i = 0; i < d->n_objects; i++)
+            wanted += d->objects[i].wanted;
+        link_log(LINK_LOG_DEBUG, LINK_LOG_SYMBOL,
+                 "Indexed %lu of %lu registered shared libraries "
+                 "(of %lu loaded objects)\n", (unsigned long)wanted,
+                 (unsigned long)d->n_wanted, (unsigned long)d->n_objects);
+    }
+
+    /* the first definition wins; if it is not ours, dlsym knows best */
+    uint32_t h = gnu_hash(name);
+    for(size_t i = 0; i < d->n_objects; i++) {
+        addr_t found = 0x0;
+        DynLookup r = lookup_in(&d->objects[i], name, h, &found);
+        if(r == DYNSYM_NOT_FOUND)
+            continue;
+        if(r == DYNSYM_FOUND && d->objects[i].wanted) {
+            *addr = found;
+            return DYNSYM_FOUND;
+        }
+        return DYNSYM_UNKNOWN;
+    }
+    return DYNSYM_NOT_FOUND;
+}
@@ -0,0 +1,73 @@
+#ifndef LINK_DYNSYM_H
+#define LINK_DYNSYM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "target.h"
+
+/*
+ * Symbol lookup in shared libraries that are already loaded into the
+ * process, by reading their .dynsym through the .gnu.hash table directly
+ * from memory.
+ *
+ * The answer has to be the one dlsym(RTLD_DEFAULT) would give: the first
+ * definition in the global scope, which allows for interposition (by the
+ * executable, or LD_PRELOAD).  Hence all loaded objects are walked, in
+ * dl_iterate_phdr (load) order, up to the first that defines the symbol;
+ * through .gnu.hash, or the SysV .hash where there is none.  Only if that
+ * first definer is a library registered with dynamic_objects_register is
+ * the symbol found here; everything else is left to dlsym.  Registered
+ * libraries are assumed to be in the global scope (not RTLD_LOCAL).
+ */
+typedef struct _DynamicObject {
+    char     * name;        /* as reported by dl_iterate_phdr */
+    bool       wanted;      /* registered */
+    addr_t     base;        /* load bias */
+    ElfSym   * symtab;
+    char     * strtab;
+    ElfHalf  * versym;      /* may be NULL */
+
+    /* SysV .hash; used only without .gnu.hash */
+    uint32_t * sysv_hash;
+
+    /* .gnu.hash */
+    uint32_t   nbuckets;
+    uint32_t   symoffset;
+    uint32_t   bloom_size;
+    uint32_t   bloom_shift;
+    ElfAddr  * bloom;
+    uint32_t * buckets;
+    uint32_t * chain;
+} DynamicObject;
+
+typedef struct _DynamicObjects {
+    /* basenames of the registered libraries */
+    char ** wanted;
+    size_t  n_wanted;
+
+    /* all loaded objects, in load order */
+    DynamicObject * objects;
+    size_t n_objects;
+
+    /* objects needs to be (re)built */
+    bool stale;
+} DynamicObjects;
+
+typedef enum _DynLookup {
+    DYNSYM_FOUND,
+    DYNSYM_NOT_FOUND,
+    /* found something we can't resolve ourselves (ifunc, tls), first found
+     * in a library that is not registered, or a library has no hash table to
+     * look in.  Ask dlsym. */
+    DYNSYM_UNKNOWN
+} DynLookup;
+
+uint32_t gnu_hash(const char * name);
+
+bool dynamic_objects_register(DynamicObjects * d, const char * name);
+void dynamic_objects_free(DynamicObjects * d);
+
+DynLookup dynamic_objects_lookup(DynamicObjects * d, const char * name,
+                                 addr_t * addr);
+
+#endif //LINK_DYNSYM_H
@@ -53,7 +53,8 @@ make_got(ObjectCode * oc) {
                            MAP_ANON | MAP_PRIVATE,
                            -1, 0);
         if (mem == MAP_FAILED) {
-            __link_log("MAP_FAILED. errno=%d", errno);
+            link_log(LINK_LOG_ERROR, LINK_LOG_MEMORY,
+                     "MAP_FAILED. errno=%d", errno);
             return EXIT_FAILURE;
         }
         oc->info->got_start = (addr_t)mem;
@@ -82,10 +83,12 @@ fill_got(Linker * l, ObjectCode * oc) {
                 if(   STT_NOTYPE == ELF_ST_TYPE(symbol->elf_sym->st_info)
                    || STB_WEAK   == ELF_ST_BIND(symbol->elf_sym->st_info)) {
                     if(0x0 == symbol->addr) {
-                        symbol->addr = lookupSymbol_(l, symbol->name);
+                        symbol->addr = lookup_symbol(l, symbol->name,
+                                                     symbol_hash(l, symbol));
                         if(0x0 == symbol->addr) {
-                            __link_log("Failed to lookup symbol: %s\n",
-                                       symbol->name);
+                            link_log(LINK_LOG_ERROR, LINK_LOG_SYMBOL,
+                                     "Failed to lookup symbol: %s\n",
+                                     symbol->name);
                             return EXIT_FAILURE;
                         }
                     } else {
@@ -95,13 +98,14 @@ fill_got(Linker * l, ObjectCode * oc) {
                   * we should have the address already.
                   */
                 if(0x0 == symbol->addr) {
-                    __link_log(
+                    link_log(LINK_LOG_ERROR, LINK_LOG_SYMBOL,
                             "Something went wrong! Symbol %s has null address.\n",
                             symbol->name);
                     return EXIT_FAILURE;
                 }
                 if(0x0 == symbol->got_addr) {
-                    __link_log("Not good either!");
+                    link_log(LINK_LOG_ERROR, LINK_LOG_SYMBOL,
+                             "Not good either!");
                     return EXIT_FAILURE;
                 }
                 *(addr_t*)symbol->got_addr = symbol->addr;
@@ -128,7 +132,8 @@ verify_got(Linker * l __attribute__((unused)), ObjectCode * oc) {
 
 void
 free_got(ObjectCode * oc) {
-//    munmap(oc->info->got_start, oc->info->got_size);
+    if(oc->info->got_start != 0x0)
+        munmap((void*)oc->info->got_start, oc->info->got_size);
     oc->info->got_start = 0x0;
     oc->info->got_size = 0;
 }
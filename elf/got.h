@@ -1,7 +1,7 @@
 #ifndef LINK_GOT_H
 #define LINK_GOT_H
 
-#include "../BinaryTree.h"
+#include "../SymbolTable.h"
 #include "../Types.h"
 #include "../Linker.h"
 
@@ -3,33 +3,121 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "plt.h"
+#include "reloc/util.h"
 
 #define _make_stub         ADD_SUFFIX(make_stub)
 #define need_stub_for_rel  ADD_SUFFIX(need_stub_for_rel)
 #define need_stub_for_rela ADD_SUFFIX(need_stub_for_rela)
 
+/*
+ * The symbols of the symbol table at index, with the section (+1) each was
+ * last counted for.  Objects have a single symbol table, as a rule.
+ */
+typedef struct _SeenSymbols {
+    unsigned   index;
+    size_t     n_symbols;
+    unsigned * section;
+    struct _SeenSymbols * next;
+} SeenSymbols;
+
+static SeenSymbols *
+seen_for(ObjectCode * oc, SeenSymbols ** seen, unsigned symbolTableIndex) {
+    for(SeenSymbols * s = *seen; s != NULL; s = s->next)
+        if(s->index == symbolTableIndex)
+            return s;
+    ElfSymbolTable * t = find_symbol_table(oc, symbolTableIndex);
+    if(t == NULL)
+        return NULL;
+    SeenSymbols * s = calloc(1, sizeof(SeenSymbols)
+                                + t->n_symbols * sizeof(unsigned));
+    assert(s != NULL);
+    s->index = symbolTableIndex;
+    s->n_symbols = t->n_symbols;
+    s->section = (unsigned *)(s + 1);
+    s->next = *seen;
+    *seen = s;
+    return s;
+}
+
+/* count sym for section, unless it was the last section it was counted for */
+static inline void
+count_target(unsigned * demand, SeenSymbols * seen, unsigned section,
+             size_t sym) {
+    if(seen == NULL || sym >= seen->n_symbols) {
+        demand[section]++; /* can't tell; count every relocation */
+    } else if(seen->section[sym] != section + 1) {
+        seen->section[sym] = section + 1;
+        demand[section]++;
+    }
+}
+
+/*
+ * One pass over all relocation tables.  Stubs are made per target, hence
+ * branches to the same symbol are counted once per section; a symbol is
+ * counted again only if tables of other sections came in between, which
+ * errs on the safe side.
+ *
+ * On arm the target includes the addend; branches to the same (section)
+ * symbol with different addends are local to the object however, and in
+ * range.  Should the space run out nonetheless, stub_for falls back to a
+ * veneer.
+ */
+static void
+count_stub_demand(ObjectCode * oc) {
+    unsigned * demand = calloc(oc->n_sections + 1, sizeof(unsigned));
+    assert(demand != NULL);
+    SeenSymbols * seen = NULL;
+
+    for(ElfRelocationTable *t = oc->info->relTable; t != NULL; t = t->next) {
+        if(t->targetSectionIndex >= oc->n_sections)
+            continue;
+        SeenSymbols * s = seen_for(oc, &seen, t->sectionHeader->sh_link);
+        for(size_t i=0; i < t->n_relocations; i++)
+            if(need_stub_for_rel(&t->relocations[i]))
+                count_target(demand, s, t->targetSectionIndex,
+                             ELF_R_SYM(t->relocations[i].r_info));
+    }
+    for(ElfRelocationATable *t = oc->info->relaTable; t != NULL; t = t->next) {
+        if(t->targetSectionIndex >= oc->n_sections)
+            continue;
+        SeenSymbols * s = seen_for(oc, &seen, t->sectionHeader->sh_link);
+        for(size_t i=0; i < t->n_relocations; i++)
+            if(need_stub_for_rela(&t->relocations[i]))
+                count_target(demand, s, t->targetSectionIndex,
+                             ELF_R_SYM(t->relocations[i].r_info));
+    }
+
+    while(seen != NULL) {
+        SeenSymbols * next = seen->next;
+        free(seen);
+        seen = next;
+    }
+    oc->info->stubDemand = demand;
+}
+
 unsigned
 numberOfStubsForSection( ObjectCode *oc, unsigned sectionIndex) {
-    unsigned n = 0;
-    for(ElfRelocationTable *t = oc->info->relTable; t != NULL; t = t->next)
-        if(t->targetSectionIndex == sectionIndex)
-            for(size_t i=0; i < t->n_relocations; i++)
-                if(need_stub_for_rel(&t->relocations[i]))
-                    n += 1;
-
-    for(ElfRelocationATable *t = oc->info->relaTable; t != NULL; t = t->next)
-        if(t->targetSectionIndex == sectionIndex)
-            for(size_t i=0; i < t->n_relocations; i++)
-                if(need_stub_for_rela(&t->relocations[i]))
-                    n += 1;
-    return n;
+    if(oc->info->stubDemand == NULL)
+        count_stub_demand(oc);
+    return sectionIndex < oc->n_sections
+           ? oc->info->stubDemand[sectionIndex] : 0;
+}
+
+static inline size_t
+stub_slot(Section * section, addr_t target) {
+    return (size_t)(((uint64_t)target * 11400714819323198485ull) >> 32)
+           & section->info->stub_map_mask;
 }
 
 bool
 find_stub(Section * section, ElfSymbol * symbol __attribute__((unused)),
-          addr_t *
-addr) {
-    for(Stub * s = section->info->stubs; s != NULL; s = s->next) {
+          addr_t * addr) {
+    SectionFormatInfo * info = section->info;
+    if(info->stubs == NULL)
+        return EXIT_FAILURE;
+    for(size_t i = stub_slot(section, *addr); info->stub_map[i] != 0;
+        i = (i + 1) & info->stub_map_mask) {
+        Stub * s = &info->stubs[info->stub_map[i] - 1];
         if(s->target == *addr) {
             *addr = s->addr;
             return EXIT_SUCCESS;
@@ -38,43 +126,84 @@ addr) {
     return EXIT_FAILURE;
 }
 
+/*
+ * The stubs and their map are allocated in one go, when the first stub is
+ * made; the stub space behind the section bounds their number.  The map is
+ * kept at most half full.
+ */
+static bool
+alloc_stubs(SectionFormatInfo * info) {
+    size_t capacity = info->stub_size > STUB_GAP
+                      ? (info->stub_size - STUB_GAP) / STUB_SIZE : 0;
+    if(capacity == 0)
+        return EXIT_FAILURE;
+    size_t slots = 2;
+    while(slots < 2 * capacity) slots <<= 1;
+    info->stubs = calloc(1, capacity * sizeof(Stub) + slots * sizeof(uint32_t));
+    assert(info->stubs != NULL);
+    info->stub_map = (uint32_t *)(info->stubs + capacity);
+    info->stub_map_mask = slots - 1;
+    return EXIT_SUCCESS;
+}
+
 bool
 make_stub(Section * section, ElfSymbol * symbol __attribute__((unused)), addr_t * addr) {
+    SectionFormatInfo * info = section->info;
+    if(info->stubs == NULL && alloc_stubs(info))
+        return EXIT_FAILURE;
+    if(STUB_GAP + STUB_SIZE * (info->nstubs + 1) > info->stub_size)
+        return EXIT_FAILURE; /* out of stub space */
 
-    Stub * s = calloc(1, sizeof(Stub));
-    assert(s != NULL);
+    Stub * s = &info->stubs[info->nstubs];
     s->target = *addr;
-    s->next = NULL;
-    s->addr = section->info->stub_offset + 8
-            + STUB_SIZE * section->info->nstubs;
+    s->addr = info->stub_offset + STUB_GAP + STUB_SIZE * info->nstubs;
 
     if((*_make_stub)(s))
         return EXIT_FAILURE;
 
-    if(section->info->stubs == NULL) {
-        assert(section->info->nstubs == 0);
-        /* no stubs yet, let's just create this one */
-        section->info->stubs = s;
-    } else {
-        Stub * tail = section->info->stubs;
-        while(tail->next != NULL) tail = tail->next;
-        tail->next = s;
-    }
-    section->info->nstubs += 1;
+    size_t i = stub_slot(section, s->target);
+    while(info->stub_map[i] != 0)
+        i = (i + 1) & info->stub_map_mask;
+    info->stub_map[i] = (uint32_t)(++info->nstubs);
     *addr = s->addr;
     return EXIT_SUCCESS;
 }
 
 void
 free_stubs(Section * section) {
-    if(section->info->nstubs == 0)
-        return;
-    Stub * last = section->info->stubs;
-    while(last->next != NULL) {
-        Stub * t = last;
-        last = last->next;
-        free(t);
-    }
+    free(section->info->stubs);
     section->info->stubs = NULL;
+    section->info->stub_map = NULL;
+    section->info->stub_map_mask = 0;
     section->info->nstubs = 0;
 }
+
+bool
+stub_for(Linker * l, Section * section, ElfSymbol * symbol, addr_t P,
+         addr_t range, addr_t * addr) {
+    addr_t target = *addr;
+    if(!find_veneer(&l->veneers, P, range, target, addr))
+        return EXIT_SUCCESS;
+    /* no stub space, or all of it taken */
+    if(section->info->stub_size == 0 || make_stub(section, symbol, addr))
+        return make_veneer(&l->veneers, &l->code, P, range, target, addr);
+    add_veneer(&l->veneers, target, *addr);
+    return EXIT_SUCCESS;
+}
+
+bool
+stub_for_local(Section * section, ElfSymbol * symbol, addr_t * addr) {
+    if(!find_stub(section, symbol, addr))
+        return EXIT_SUCCESS;
+    return section->info->stub_size == 0 || make_stub(section, symbol, addr);
+}
+
+void
+share_stubs(Linker * l, ObjectCode * oc) {
+    for(unsigned i = 0; i < oc->n_sections; i++) {
+        SectionFormatInfo * info = oc->sections[i].info;
+        for(size_t k = 0; k < info->nstubs; k++)
+            add_veneer(&l->veneers, info->stubs[k].target,
+                       info->stubs[k].addr);
+    }
+}
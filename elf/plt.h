@@ -1,4 +1,5 @@
 #include "../Types.h"
+#include "../Linker.h"
 #include "plt/arm.h"
 #include "plt/arm64.h"
 
@@ -7,10 +8,30 @@
 unsigned  numberOfStubsForSection( ObjectCode *oc, unsigned sectionIndex);
 
 #define STUB_SIZE          ADD_SUFFIX(stub_size)
+/* make_stub places the first stub this far into the stub space */
+#define STUB_GAP           8
 
 bool find_stub(Section * section, ElfSymbol * symbol, addr_t * addr);
 bool make_stub(Section * section, ElfSymbol * symbol, addr_t * addr);
 
 void free_stubs(Section * section);
 
+/*
+ * For a branch at P to *addr, out of range: replace *addr with the address
+ * of a veneer within range of the branch, shared if possible; see
+ * elf/veneer.h.
+ */
+bool stub_for(Linker * l, Section * section, ElfSymbol * symbol, addr_t P,
+              addr_t range, addr_t * addr);
+
+/*
+ * stub_for, touching nothing but the section: the stub to *addr in the
+ * section's own stub space, made if need be.  EXIT_FAILURE if there is no
+ * room.  See relocate_object_code_local.
+ */
+bool stub_for_local(Section * section, ElfSymbol * symbol, addr_t * addr);
+
+/* Register the stubs of oc's sections as veneers, to be shared. */
+void share_stubs(Linker * l, ObjectCode * oc);
+
 #endif //LINK_PLT_H
@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include "arm.h"
+#include "../reloc/arm_relocs.h"
 
 /* three 4 byte instructions */
 const size_t stub_size_arm = 12;
@@ -18,30 +19,14 @@ const size_t stub_size_arm = 12;
  * be relocated is minimal.
  */
 bool need_stub_for_rel_arm(ElfRel * rel) {
-    switch(ELF32_R_TYPE(rel->r_info)) {
-        case ARM_PC24:
-        case ARM_CALL:
-        case ARM_JUMP24:
-        case ARM_THM_CALL:
-        case ARM_THM_JUMP24:
-        case ARM_THM_JUMP19:
-            return true;
-        default:
-            return false;
-    }
+    unsigned long type = ELF32_R_TYPE(rel->r_info);
+    return type < n_reloc_descriptors_arm
+           && reloc_descriptors_arm[type].stub;
 }
 bool need_stub_for_rela_arm(ElfRela * rela) {
-    switch(ELF32_R_TYPE(rela->r_info)) {
-        case ARM_PC24:
-        case ARM_CALL:
-        case ARM_JUMP24:
-        case ARM_THM_CALL:
-        case ARM_THM_JUMP24:
-        case ARM_THM_JUMP19:
-            return true;
-        default:
-            return false;
-    }
+    unsigned long type = ELF32_R_TYPE(rela->r_info);
+    return type < n_reloc_descriptors_arm
+           && reloc_descriptors_arm[type].stub;
 }
 
 bool
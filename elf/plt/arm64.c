@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include "arm64.h"
+#include "../reloc/arm64_relocs.h"
 
 /* five 4 byte instructions */
 const size_t inst_size_arm64 = 4;
@@ -17,22 +18,14 @@ const size_t stub_size_arm64 = 5 * 4;
  * be relocated is minimal.
  */
 bool need_stub_for_rel_arm64(ElfRel * rel) {
-    switch(ELF64_R_TYPE(rel->r_info)) {
-        case AARCH64_CALL26:
-        case AARCH64_JUMP26:
-            return true;
-        default:
-            return false;
-    }
+    unsigned long type = ELF64_R_TYPE(rel->r_info);
+    return type < n_reloc_descriptors_arm64
+           && reloc_descriptors_arm64[type].stub;
 }
 bool need_stub_for_rela_arm64(ElfRela * rela) {
-    switch(ELF64_R_TYPE(rela->r_info)) {
-        case AARCH64_CALL26:
-        case AARCH64_JUMP26:
-            return true;
-        default:
-            return false;
-    }
+    unsigned long type = ELF64_R_TYPE(rela->r_info);
+    return type < n_reloc_descriptors_arm64
+           && reloc_descriptors_arm64[type].stub;
 }
 
 
@@ -3,6 +3,16 @@
 #include "target.h"
 
 bool
-relocate_object_code(ObjectCode * oc) {
-    return ADD_SUFFIX(relocate_object_code)(oc);
+relocate_object_code(Linker * l, ObjectCode * oc) {
+    return ADD_SUFFIX(relocate_object_code)(l, oc, false);
+}
+
+bool
+relocate_object_code_local(Linker * l, ObjectCode * oc) {
+    return ADD_SUFFIX(relocate_object_code)(l, oc, true);
+}
+
+bool
+relocate_deferred(Linker * l, ObjectCode * oc) {
+    return ADD_SUFFIX(relocate_deferred)(l, oc);
 }
\ No newline at end of file
@@ -2,11 +2,24 @@
 #define LINK_RELOC_H
 
 #include "../Types.h"
-#include "../BinaryTree.h"
+#include "../SymbolTable.h"
 #include "reloc/arm.h"
 #include "reloc/arm64.h"
 
 bool
-relocate_object_code(ObjectCode * oc);
+relocate_object_code(Linker * l, ObjectCode * oc);
+
+/*
+ * relocate_object_code, touching nothing outside the object, for resolveAll:
+ * branches out of range only use stubs in their own section's stub space,
+ * and are deferred if there is no room left.  The deferred relocations are
+ * kept with the object, and applied by relocate_deferred, through veneers
+ * shared with other objects.
+ */
+bool
+relocate_object_code_local(Linker * l, ObjectCode * oc);
+
+bool
+relocate_deferred(Linker * l, ObjectCode * oc);
 
 #endif //LINK_RELOC_H
@@ -1,6 +1,9 @@
 #ifndef LINK_ARM_H
 #define LINK_ARM_H
 #include "../../Types.h"
+#include "../../Linker.h"
 bool
-relocate_object_code_arm(ObjectCode * oc);
+relocate_object_code_arm(Linker * l, ObjectCode * oc, bool local);
+bool
+relocate_deferred_arm(Linker * l, ObjectCode * oc);
 #endif //LINK_ARM_H
@@ -1,6 +1,9 @@
 #ifndef LINK_ARM64_H
 #define LINK_ARM64_H
 #include "../../Types.h"
+#include "../../Linker.h"
 bool
-relocate_object_code_arm64(ObjectCode * oc);
+relocate_object_code_arm64(Linker * l, ObjectCode * oc, bool local);
+bool
+relocate_deferred_arm64(Linker * l, ObjectCode * oc);
 #endif //LINK_ARM64_H
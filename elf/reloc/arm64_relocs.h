@@ -0,0 +1,52 @@
+#ifndef LINK_ARM64_RELOCS_H
+#define LINK_ARM64_RELOCS_H
+
+#include "descriptor.h"
+#include "../compat.h"
+
+/*
+ * The AArch64 relocations we support; see descriptor.h for the columns, and
+ * "ELF for the ARM 64-bit Architecture" for the types.
+ *
+ * - adrp <Xd>, <label>: immlo is bits 30:29, immhi bits 23:5; they take
+ *   bits 13:12 and 32:14 of the page offset.
+ * - add <Xd>, <Xn>, #imm12 and ldr/str <Xt>, [<Xn>, #imm12]: imm12 is
+ *   bits 21:10; for loads and stores scaled by the access size, which the
+ *   offset must be aligned to.
+ * - b and bl <label>: imm26 is bits 25:0; the offset in words.
+ *
+ * There is no PC bias to accommodate in the relocation of a place
+ * containing an instruction that formulates a PC-relative address.
+ *
+ * ADR_GOT_PAGE is Page(G(GDAT(S+A))) - Page(P); we do what seemingly
+ * everyone else does, and reduce it to Page(GOT(S)+A) - Page(P).
+ */
+#define ADRP_IMM       FIELDS(0x60000000, 12, 29, 0x00ffffe0, 14, 5)
+#define IMM12(scale)   FIELD(0x003ffc00, scale, 10)
+#define IMM26          FIELD(0x03ffffff, 2, 0)
+
+#define AARCH64_RELOCS(RELOC)                                                \
+/*  type                         formula          w  fields    ovf al stub  got */ \
+RELOC(AARCH64_ABS64,              RELOC_S_A,       8, WORD,      0, 0, false, false) \
+RELOC(AARCH64_ABS32,              RELOC_S_A,       4, WORD,     32, 0, false, false) \
+RELOC(AARCH64_ABS16,              RELOC_S_A,       2, WORD,     16, 0, false, false) \
+RELOC(AARCH64_PREL64,             RELOC_S_A_P,     8, WORD,      0, 0, false, false) \
+RELOC(AARCH64_PREL32,             RELOC_S_A_P,     4, WORD,     32, 0, false, false) \
+RELOC(AARCH64_PREL16,             RELOC_S_A_P,     2, WORD,     16, 0, false, false) \
+RELOC(AARCH64_ADR_PREL_PG_HI21,   RELOC_PAGE_S_A_P,4, ADRP_IMM, 33, 0, false, false) \
+RELOC(AARCH64_ADD_ABS_LO12_NC,    RELOC_S_A_LO12,  4, IMM12(0),  0, 0, false, false) \
+RELOC(AARCH64_JUMP26,             RELOC_S_A_P,     4, IMM26,    28, 0, true,  false) \
+RELOC(AARCH64_CALL26,             RELOC_S_A_P,     4, IMM26,    28, 0, true,  false) \
+RELOC(AARCH64_LDST8_ABS_LO12_NC,  RELOC_S_A_LO12,  4, IMM12(0),  0, 0, false, false) \
+RELOC(AARCH64_LDST16_ABS_LO12_NC, RELOC_S_A_LO12,  4, IMM12(1),  0, 1, false, false) \
+RELOC(AARCH64_LDST32_ABS_LO12_NC, RELOC_S_A_LO12,  4, IMM12(2),  0, 2, false, false) \
+RELOC(AARCH64_LDST64_ABS_LO12_NC, RELOC_S_A_LO12,  4, IMM12(3),  0, 3, false, false) \
+RELOC(AARCH64_LDST128_ABS_LO12_NC,RELOC_S_A_LO12,  4, IMM12(4),  0, 4, false, false) \
+RELOC(AARCH64_ADR_GOT_PAGE,       RELOC_PAGE_S_A_P,4, ADRP_IMM, 33, 0, false, true)  \
+RELOC(AARCH64_LD64_GOT_LO12_NC,   RELOC_S_A_LO12,  4, IMM12(3),  0, 3, false, true)
+
+/* the descriptors by type, generated from the list; zero for other types */
+extern const RelocDescriptor reloc_descriptors_arm64[];
+extern const size_t n_reloc_descriptors_arm64;
+
+#endif //LINK_ARM64_RELOCS_H
@@ -0,0 +1,41 @@
+#ifndef LINK_ARM_RELOCS_H
+#define LINK_ARM_RELOCS_H
+
+#include "descriptor.h"
+#include "../compat.h"
+
+/*
+ * The ARM relocations we support; see descriptor.h for the columns, and
+ * "ELF for the ARM Architecture" for the types.
+ *
+ * - bl<c> and b<c> <label> (Encoding A1): imm24 is bits 23:0; the offset in
+ *   words.  blx <label> (Encoding A2) would keep a half word in bit 24 (H);
+ *   we don't produce it.
+ * - T, the thumb bit of the formulas, is 0; we don't support thumb.
+ *
+ * PC24 and the thumb branches are not supported, but are listed for their
+ * stub demand; see need_stub_for_rel_arm.  The thumb branches keep their
+ * range (bl/b.w +-16 MiB, b<c>.w +-1 MiB), for reloc_range.
+ *
+ * PREL31 is written as a word; its top bit is not kept.
+ */
+#define IMM24 FIELD(0x00ffffff, 2, 0)
+
+#define ARM_RELOCS(RELOC)                                                    \
+/*  type            formula      w  fields ovf al stub  got */                \
+RELOC(ARM_PC24,       RELOC_NONE,  0, WORD,   0, 0, true,  false)             \
+RELOC(ARM_ABS32,      RELOC_S_A,   4, WORD,   0, 0, false, false)             \
+RELOC(ARM_REL32,      RELOC_S_A_P, 4, WORD,  32, 0, false, false)             \
+RELOC(ARM_CALL,       RELOC_S_A_P, 4, IMM24, 26, 0, true,  false)             \
+RELOC(ARM_JUMP24,     RELOC_S_A_P, 4, IMM24, 26, 0, true,  false)             \
+RELOC(ARM_THM_CALL,   RELOC_NONE,  0, WORD,  25, 0, true,  false)             \
+RELOC(ARM_THM_JUMP24, RELOC_NONE,  0, WORD,  25, 0, true,  false)             \
+RELOC(ARM_THM_JUMP19, RELOC_NONE,  0, WORD,  21, 0, true,  false)             \
+RELOC(ARM_PREL31,     RELOC_S_A_P, 4, WORD,   0, 0, false, false)             \
+RELOC(ARM_GOT_PREL,   RELOC_S_A_P, 4, WORD,   0, 0, false, true)
+
+/* the descriptors by type, generated from the list; zero for other types */
+extern const RelocDescriptor reloc_descriptors_arm[];
+extern const size_t n_reloc_descriptors_arm;
+
+#endif //LINK_ARM_RELOCS_H
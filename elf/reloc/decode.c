@@ -0,0 +1,324 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "decode.h"
+#include "util.h"
+#include "../../debug.h"
+
+/* the tables of a loaded section; one of rel and rela is set */
+typedef struct _TableRef {
+    unsigned              target;
+    ElfRelocationTable  * rel;
+    ElfRelocationATable * rela;
+} TableRef;
+
+static size_t
+collect_tables(ObjectCode * oc, TableRef ** tables) {
+    size_t n = 0;
+    for(ElfRelocationTable *t = oc->info->relTable; t != NULL; t = t->next)
+        n++;
+    for(ElfRelocationATable *t = oc->info->relaTable; t != NULL; t = t->next)
+        n++;
+    TableRef * refs = calloc(n + 1, sizeof(TableRef));
+    assert(refs != NULL);
+
+    n = 0;
+    for(ElfRelocationTable *t = oc->info->relTable; t != NULL; t = t->next)
+        if(SECTIONKIND_OTHER != oc->sections[t->targetSectionIndex].kind)
+            refs[n++] = (TableRef){ .target = t->targetSectionIndex,
+                                    .rel = t };
+    for(ElfRelocationATable *t = oc->info->relaTable; t != NULL; t = t->next)
+        if(SECTIONKIND_OTHER != oc->sections[t->targetSectionIndex].kind)
+            refs[n++] = (TableRef){ .target = t->targetSectionIndex,
+                                    .rela = t };
+
+    /* by section; there are few tables, and REL goes before RELA */
+    for(size_t i = 1; i < n; i++) {
+        TableRef r = refs[i];
+        size_t j = i;
+        for(; j > 0 && refs[j-1].target > r.target; j--)
+            refs[j] = refs[j-1];
+        refs[j] = r;
+    }
+    *tables = refs;
+    return n;
+}
+
+typedef struct _Decoded {
+    addr_t      P, S, A;
+    ElfSymbol * symbol;
+    unsigned    section;
+} Decoded;
+
+static int
+by_section_and_place(const void * a, const void * b) {
+    const Decoded * x = a, * y = b;
+    if(x->section != y->section)
+        return x->section < y->section ? -1 : 1;
+    return x->P < y->P ? -1 : x->P > y->P;
+}
+
+/* objects emit their tables ordered by offset as a rule; sort otherwise */
+static void
+sort_run(DecodedRelocations * d, const RelocRun * r) {
+    bool sorted = true;
+    for(size_t i = r->start + 1; i < r->end && sorted; i++)
+        sorted = d->section[i-1] < d->section[i]
+                 || (d->section[i-1] == d->section[i] && d->P[i-1] <= d->P[i]);
+    if(sorted)
+        return;
+
+    size_t n = r->end - r->start;
+    Decoded * tmp = calloc(n, sizeof(Decoded));
+    assert(tmp != NULL);
+    for(size_t i = 0; i < n; i++) {
+        size_t k = r->start + i;
+        tmp[i] = (Decoded){ d->P[k], d->S[k], d->A[k], d->symbol[k],
+                            d->section[k] };
+    }
+    qsort(tmp, n, sizeof(Decoded), by_section_and_place);
+    for(size_t i = 0; i < n; i++) {
+        size_t k = r->start + i;
+        d->P[k] = tmp[i].P;
+        d->S[k] = tmp[i].S;
+        d->A[k] = tmp[i].A;
+        d->symbol[k]  = tmp[i].symbol;
+        d->section[k] = tmp[i].section;
+    }
+    free(tmp);
+}
+
+/* place the relocation into the slot of its type */
+static inline bool
+decode_one(DecodedRelocations * d, size_t * next, unsigned section,
+           Section * s, ElfSymbolTable * symtab, addr_t offset,
+           unsigned long info, addr_t A) {
+    ElfSymbol * symbol = table_symbol(symtab, ELF_R_SYM(info));
+    if(symbol == NULL)
+        return EXIT_FAILURE;
+    size_t k = next[ELF_R_TYPE(info)]++;
+    d->P[k] = s->start + offset;
+    d->S[k] = symbol->addr;
+    d->A[k] = A;
+    d->symbol[k] = symbol;
+    d->section[k] = section;
+    return EXIT_SUCCESS;
+}
+
+bool
+decode_relocations(ObjectCode * oc, implicit_addend decode,
+                   DecodedRelocations * d) {
+    memset(d, 0, sizeof(DecodedRelocations));
+    TableRef * tables = NULL;
+    size_t n_tables = collect_tables(oc, &tables);
+
+    /* count by type */
+    size_t * next = calloc(RELOC_TYPES, sizeof(size_t));
+    assert(next != NULL);
+    for(size_t t = 0; t < n_tables; t++) {
+        size_t n = tables[t].rel != NULL ? tables[t].rel->n_relocations
+                                         : tables[t].rela->n_relocations;
+        for(size_t i = 0; i < n; i++) {
+            unsigned long type = tables[t].rel != NULL
+                    ? ELF_R_TYPE(tables[t].rel->relocations[i].r_info)
+                    : ELF_R_TYPE(tables[t].rela->relocations[i].r_info);
+            if(type >= RELOC_TYPES) {
+                link_log(LINK_LOG_ERROR, LINK_LOG_RELOC,
+                         "unsupported relocation type %lu\n", type);
+                free(next);
+                free(tables);
+                return EXIT_FAILURE;
+            }
+            next[type]++;
+        }
+        d->n += n;
+    }
+
+    /* a run per type, in order of the types */
+    d->runs = calloc(RELOC_TYPES, sizeof(RelocRun));
+    assert(d->runs != NULL);
+    size_t start = 0;
+    for(unsigned type = 0; type < RELOC_TYPES; type++) {
+        if(next[type] == 0)
+            continue;
+        d->runs[d->n_runs++] = (RelocRun){ .type = type, .start = start,
+                                           .end = start + next[type] };
+        size_t count = next[type];
+        next[type] = start;
+        start += count;
+    }
+
+    d->P       = calloc(d->n + 1, sizeof(addr_t));
+    d->S       = calloc(d->n + 1, sizeof(addr_t));
+    d->A       = calloc(d->n + 1, sizeof(addr_t));
+    d->symbol  = calloc(d->n + 1, sizeof(ElfSymbol *));
+    d->section = calloc(d->n + 1, sizeof(unsigned));
+    assert(d->P != NULL && d->S != NULL && d->A != NULL
+           && d->symbol != NULL && d->section != NULL);
+
+    bool r = EXIT_SUCCESS;
+    for(size_t t = 0; t < n_tables && !r; t++) {
+        Section * s = &oc->sections[tables[t].target];
+        if(tables[t].rel != NULL) {
+            ElfRelocationTable * tab = tables[t].rel;
+            for(size_t i = 0; i < tab->n_relocations && !r; i++) {
+                ElfRel * rel = &tab->relocations[i];
+                r = decode_one(d, next, tables[t].target, s, tab->symbolTable,
+                               rel->r_offset, rel->r_info, decode(s, rel));
+            }
+        } else {
+            ElfRelocationATable * tab = tables[t].rela;
+            for(size_t i = 0; i < tab->n_relocations && !r; i++) {
+                ElfRela * rela = &tab->relocations[i];
+                r = decode_one(d, next, tables[t].target, s, tab->symbolTable,
+                               rela->r_offset, rela->r_info,
+                               (addr_t)rela->r_addend);
+            }
+        }
+    }
+    free(next);
+    free(tables);
+    if(r) {
+        link_log(LINK_LOG_ERROR, LINK_LOG_RELOC, "relocation without symbol\n");
+        free_decoded_relocations(d);
+        return EXIT_FAILURE;
+    }
+
+    for(size_t i = 0; i < d->n_runs; i++)
+        sort_run(d, &d->runs[i]);
+    return EXIT_SUCCESS;
+}
+
+void
+free_decoded_relocations(DecodedRelocations * d) {
+    free(d->P);
+    free(d->S);
+    free(d->A);
+    free(d->symbol);
+    free(d->section);
+    free(d->runs);
+    free(d->deferred);
+    memset(d, 0, sizeof(DecodedRelocations));
+}
+
+void
+defer_relocation(DecodedRelocations * d, size_t i) {
+    if(d->n_deferred == d->deferred_size) {
+        d->deferred_size = d->deferred_size > 0 ? 2 * d->deferred_size : 16;
+        d->deferred = realloc(d->deferred,
+                              d->deferred_size * sizeof(size_t));
+        assert(d->deferred != NULL);
+    }
+    assert(d->n_deferred == 0 || d->deferred[d->n_deferred - 1] < i);
+    d->deferred[d->n_deferred++] = i;
+}
+
+DecodedRelocations *
+take_deferred(DecodedRelocations * d) {
+    if(d->n_deferred == 0)
+        return NULL;
+    DecodedRelocations * e = calloc(1, sizeof(DecodedRelocations));
+    assert(e != NULL);
+    e->n       = d->n_deferred;
+    e->P       = calloc(e->n, sizeof(addr_t));
+    e->S       = calloc(e->n, sizeof(addr_t));
+    e->A       = calloc(e->n, sizeof(addr_t));
+    e->symbol  = calloc(e->n, sizeof(ElfSymbol *));
+    e->section = calloc(e->n, sizeof(unsigned));
+    e->runs    = calloc(d->n_runs, sizeof(RelocRun));
+    assert(e->P != NULL && e->S != NULL && e->A != NULL
+           && e->symbol != NULL && e->section != NULL && e->runs != NULL);
+
+    /* the runs are in order, and so are the relocations deferred */
+    const RelocRun * r = d->runs;
+    for(size_t k = 0; k < e->n; k++) {
+        size_t i = d->deferred[k];
+        while(i >= r->end)
+            r++;
+        if(e->n_runs == 0 || e->runs[e->n_runs - 1].type != r->type)
+            e->runs[e->n_runs++] = (RelocRun){ .type = r->type, .start = k };
+        e->runs[e->n_runs - 1].end = k + 1;
+        e->P[k] = d->P[i];
+        e->S[k] = d->S[i];
+        e->A[k] = d->A[i];
+        e->symbol[k]  = d->symbol[i];
+        e->section[k] = d->section[i];
+    }
+    free(d->deferred);
+    d->deferred = NULL;
+    d->n_deferred = d->deferred_size = 0;
+    return e;
+}
+
+/*
+ * The data kernels work on a vector of LANES relocations at a time (GCC
+ * vector extensions; NEON on arm and arm64).  Places that follow each other
+ * word by word, as in info tables, are stored as a vector, too.
+ */
+#define LANES (16 / sizeof(addr_t))
+typedef addr_t addr_vec __attribute__((vector_size(16)));
+
+static inline addr_vec
+load_vec(const addr_t * p) {
+    addr_vec v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline bool
+consecutive(const addr_t * P, size_t width) {
+    for(size_t k = 1; k < LANES; k++)
+        if(P[k] != P[0] + k * width)
+            return false;
+    return true;
+}
+
+void
+reloc_abs(const DecodedRelocations * d, const RelocRun * r) {
+    const addr_t * P = d->P, * S = d->S, * A = d->A;
+    size_t i = r->start;
+    for(; i + LANES <= r->end; i += LANES) {
+        addr_vec v = load_vec(S + i) + load_vec(A + i);
+        if(consecutive(P + i, sizeof(addr_t))) {
+            memcpy((void *)P[i], &v, sizeof(v));
+        } else {
+            for(size_t k = 0; k < LANES; k++)
+                memcpy((void *)P[i + k], &v[k], sizeof(addr_t));
+        }
+    }
+    for(; i < r->end; i++) {
+        addr_t v = S[i] + A[i];
+        memcpy((void *)P[i], &v, sizeof(addr_t));
+    }
+}
+
+bool
+reloc_prel32(const DecodedRelocations * d, const RelocRun * r) {
+    const addr_t * P = d->P, * S = d->S, * A = d->A;
+    size_t i = r->start;
+    addr_vec overflow = { 0 };
+    for(; i + LANES <= r->end; i += LANES) {
+        addr_vec p = load_vec(P + i);
+        addr_vec v = load_vec(S + i) + load_vec(A + i) - p;
+#if defined(__LP64__)
+        /* fits into 32 bits, signed, iff the upper 33 bits are alike */
+        overflow |= (v + 0x80000000) >> 32;
+#endif
+        for(size_t k = 0; k < LANES; k++) {
+            uint32_t w = (uint32_t)v[k];
+            memcpy((void *)p[k], &w, sizeof(w));
+        }
+    }
+    for(; i < r->end; i++) {
+        addr_t v = S[i] + A[i] - P[i];
+#if defined(__LP64__)
+        overflow[0] |= (v + 0x80000000) >> 32;
+#endif
+        uint32_t w = (uint32_t)v;
+        memcpy((void *)P[i], &w, sizeof(w));
+    }
+    for(size_t k = 0; k < LANES; k++)
+        if(overflow[k] != 0)
+            return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
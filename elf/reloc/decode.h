@@ -0,0 +1,85 @@
+#ifndef LINK_DECODE_H
+#define LINK_DECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Types.h"
+
+/*
+ * The relocations of an object, decoded up front.
+ *
+ * All REL and RELA tables of the object's loaded sections are decoded into
+ * parallel arrays: the place P, the symbol's address S, and the addend A
+ * (explicit, or decoded from the place).  The relocations are grouped by
+ * type into runs, and ordered by section and offset within a run.  Each run
+ * is then applied by a loop specialized for its type; see reloc_abs and
+ * reloc_prel32 for the data relocations, which are most of them.
+ *
+ * Addends are kept as addr_t, two's complement; S + A wraps alike.  Implicit
+ * addends are all decoded before the first place is written.
+ */
+typedef struct _RelocRun {
+    unsigned type;
+    size_t   start;
+    size_t   end;
+} RelocRun;
+
+typedef struct _DecodedRelocations {
+    size_t       n;
+    addr_t     * P;
+    addr_t     * S;
+    addr_t     * A;
+    ElfSymbol ** symbol;
+    unsigned   * section;   /* the index of the section P is in */
+
+    RelocRun   * runs;      /* by type, ascending */
+    size_t       n_runs;
+
+    /* branches out of range may only use stubs of their own section (see
+     * relocate_object_code_local); those that find no room are deferred */
+    bool         local;
+    size_t     * deferred;  /* ascending */
+    size_t       n_deferred;
+    size_t       deferred_size;
+} DecodedRelocations;
+
+/* relocation types are below this, on all targets */
+#define RELOC_TYPES 1024
+
+/* decodes the implicit addend of a REL relocation */
+typedef addr_t (*implicit_addend)(Section * section, ElfRel * rel);
+
+/*
+ * Decode the relocations of oc; symbols must have their addresses.  Returns
+ * EXIT_FAILURE for a relocation of a type beyond RELOC_TYPES, or without a
+ * symbol.
+ */
+bool
+decode_relocations(ObjectCode * oc, implicit_addend decode,
+                   DecodedRelocations * d);
+
+void
+free_decoded_relocations(DecodedRelocations * d);
+
+/* Leave relocation i (of the run being applied) to a later pass. */
+void
+defer_relocation(DecodedRelocations * d, size_t i);
+
+/*
+ * The relocations deferred, decoded relocations of their own (in runs, as
+ * above), for the later pass; NULL if there are none.  Release with
+ * free_decoded_relocations and free.
+ */
+DecodedRelocations *
+take_deferred(DecodedRelocations * d);
+
+/* *P = S + A, for the run; an address wide (ABS64, or ABS32 on arm) */
+void
+reloc_abs(const DecodedRelocations * d, const RelocRun * r);
+
+/* *P = S + A - P, for the run; 32 bits wide (PREL32, or REL32 on arm).
+ * Returns EXIT_FAILURE if a value does not fit. */
+bool
+reloc_prel32(const DecodedRelocations * d, const RelocRun * r);
+
+#endif //LINK_DECODE_H
@@ -0,0 +1,142 @@
+#ifndef LINK_DESCRIPTOR_H
+#define LINK_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "../../Types.h"
+
+/*
+ * Relocation descriptors.
+ *
+ * Each target lists the relocation types it supports once, as an X-macro
+ * (see arm64_relocs.h and arm_relocs.h), with a row per type:
+ *
+ *   RELOC(type, formula, width, fields, overflow, align, stub, got)
+ *
+ *   formula   the value V to relocate with; see RelocFormula
+ *   width     of the place, in bytes
+ *   fields    where V goes in the place: ((V >> shr) << shl) & mask, for up
+ *             to two fields; WORD for all of it
+ *   overflow  V must fit this many bits, signed; 0 if it is not checked
+ *   align     the low align bits of V must be 0
+ *   stub      out of range, the type branches via a stub; see stub_for
+ *   got       the formula uses the symbol's GOT slot instead of S
+ *
+ * The targets generate their relocate loops from the list, one per type,
+ * with the descriptor a constant; the helpers below then fold into the few
+ * instructions each type needs, without branches.  The list also generates
+ * a table of the descriptors by type, for code that asks about types at
+ * runtime; see need_stub_for_rel.
+ */
+typedef enum _RelocFormula {
+    RELOC_NONE,        /* not supported; listed for stub or got only */
+    RELOC_S_A,         /* S + A */
+    RELOC_S_A_P,       /* S + A - P */
+    RELOC_PAGE_S_A_P,  /* Page(S + A) - Page(P) */
+    RELOC_S_A_LO12,    /* (S + A) & 0xfff */
+} RelocFormula;
+
+typedef struct _RelocField {
+    uint64_t mask;
+    uint8_t  shr, shl;
+} RelocField;
+
+typedef struct _RelocDescriptor {
+    RelocFormula formula;
+    uint8_t      width;
+    RelocField   fields[2];
+    uint8_t      overflow;
+    uint8_t      align;
+    bool         stub;
+    bool         got;
+} RelocDescriptor;
+
+#define WORD                  { { ~(uint64_t)0, 0, 0 } }
+#define FIELD(mask, shr, shl) { { mask, shr, shl } }
+#define FIELDS(mask, shr, shl, mask2, shr2, shl2)                            \
+    { { mask, shr, shl }, { mask2, shr2, shl2 } }
+
+#define RELOC_DESCRIPTOR(type, formula, width, fields, overflow, align,      \
+                         stub, got)                                          \
+    [type] = { formula, width, fields, overflow, align, stub, got },
+
+#define RELOC_PAGE(x) ((x) & ~(addr_t)0xfff)
+
+static inline __attribute__((always_inline)) addr_t
+reloc_value(RelocFormula formula, addr_t S, addr_t A, addr_t P) {
+    switch(formula) {
+        case RELOC_S_A:        return S + A;
+        case RELOC_S_A_P:      return S + A - P;
+        case RELOC_PAGE_S_A_P: return RELOC_PAGE(S + A) - RELOC_PAGE(P);
+        case RELOC_S_A_LO12:   return (S + A) & 0xfff;
+        default:
+            abort(/* not supported */);
+    }
+}
+
+/* V fits the overflow bits, signed */
+static inline __attribute__((always_inline)) bool
+reloc_fits(unsigned overflow, addr_t V) {
+    if(overflow == 0 || overflow >= 8 * sizeof(addr_t))
+        return true;
+    return ((V + ((addr_t)1 << (overflow - 1))) >> overflow) == 0;
+}
+
+/* how far a branch of descriptor D reaches, either way */
+static inline __attribute__((always_inline)) addr_t
+reloc_range(const RelocDescriptor D) {
+    return (addr_t)1 << (D.overflow - 1);
+}
+
+/* non-zero if V overflows, or is not aligned */
+static inline __attribute__((always_inline)) addr_t
+reloc_check(const RelocDescriptor D, addr_t V) {
+    return (addr_t)!reloc_fits(D.overflow, V)
+           | (V & (((addr_t)1 << D.align) - 1));
+}
+
+/* write V into the fields of the place P; places are little endian */
+static inline __attribute__((always_inline)) void
+reloc_encode(const RelocDescriptor D, addr_t P, addr_t V) {
+    uint64_t mask = D.fields[0].mask | D.fields[1].mask;
+    uint64_t w = 0;
+    if(D.width < 8 ? (~mask & ((UINT64_C(1) << (8 * D.width)) - 1))
+                   : ~mask)
+        memcpy(&w, (void *)P, D.width);
+    w = (w & ~mask)
+        | (((uint64_t)V >> D.fields[0].shr << D.fields[0].shl)
+           & D.fields[0].mask)
+        | (((uint64_t)V >> D.fields[1].shr << D.fields[1].shl)
+           & D.fields[1].mask);
+    memcpy((void *)P, &w, D.width);
+}
+
+/* the value in the fields of the place P, sign extended; the inverse of
+ * reloc_encode, for implicit addends */
+static inline addr_t
+reloc_decode(const RelocDescriptor D, addr_t P) {
+    uint64_t w = 0;
+    memcpy(&w, (void *)P, D.width);
+    uint64_t V = ((w & D.fields[0].mask) >> D.fields[0].shl
+                  << D.fields[0].shr)
+                 | ((w & D.fields[1].mask) >> D.fields[1].shl
+                    << D.fields[1].shr);
+    unsigned bits = D.overflow != 0 ? D.overflow : 8 * D.width;
+    if(bits < 64 && (V >> (bits - 1) & 1))
+        V |= ~UINT64_C(0) << bits;
+    return (addr_t)V;
+}
+
+/* the run can use reloc_abs or reloc_prel32 (see decode.h) */
+#define reloc_is_abs(D)                                                      \
+    ((D).formula == RELOC_S_A && !(D).got && (D).width == sizeof(addr_t)     \
+     && (D).fields[0].mask == ~(uint64_t)0 && (D).fields[1].mask == 0        \
+     && (D).overflow == 0 && (D).align == 0)
+#define reloc_is_prel32(D)                                                   \
+    ((D).formula == RELOC_S_A_P && !(D).got && (D).width == 4                \
+     && (D).fields[0].mask == ~(uint64_t)0 && (D).fields[1].mask == 0        \
+     && (D).overflow == 32 && (D).align == 0)
+
+#endif //LINK_DESCRIPTOR_H
@@ -31,4 +31,11 @@ ElfSymbolTable * find_symbol_table(ObjectCode * oc,
 ElfSymbol * find_symbol(ObjectCode * oc,
                         unsigned symbolTableIndex,
                         unsigned long symbolIndex);
+
+/* The symbol at symbolIndex of a relocation table's (bound) symbol table. */
+static inline ElfSymbol *
+table_symbol(ElfSymbolTable * t, unsigned long symbolIndex) {
+    return t != NULL && symbolIndex < t->n_symbols
+           ? &t->symbols[symbolIndex] : NULL;
+}
 #endif //LINK_UTIL_H
@@ -25,8 +25,13 @@ typedef Elf64_Rela ElfRela;
 
 typedef Elf64_Word ElfWord;
 typedef Elf64_Half ElfHalf;
+typedef Elf64_Dyn  ElfDyn;
 
 typedef uint64_t addr_t;
+
+#define ELF_R_SYM(info)        ELF64_R_SYM(info)
+#define ELF_R_TYPE(info)       ELF64_R_TYPE(info)
+#define ELF_R_INFO(sym, type)  ELF64_R_INFO(sym, type)
 #elif defined(__i386__) || defined(__arm__) || defined(__mips__)
 typedef Elf32_Ehdr ElfEhdr;
 typedef Elf32_Phdr ElfPhdr;
@@ -39,24 +44,35 @@ typedef Elf32_Rela ElfRela;
 
 typedef Elf32_Word ElfWord;
 typedef Elf32_Half ElfHalf;
+typedef Elf32_Dyn  ElfDyn;
 
 typedef uint32_t addr_t;
+
+#define ELF_R_SYM(info)        ELF32_R_SYM(info)
+#define ELF_R_TYPE(info)       ELF32_R_TYPE(info)
+#define ELF_R_INFO(sym, type)  ELF32_R_INFO(sym, type)
 #else
 #error "unknown architecture"
 #endif
 
 #if defined(__x86_64__)
 #define __suffix__ x86_64
+#define ELF_MACHINE EM_X86_64
 #elif defined(__aarch64__)
 #define __suffix__ arm64
+#define ELF_MACHINE EM_AARCH64
 #elif defined(__mips64__)
 #define __suffix__ mips64
+#define ELF_MACHINE EM_MIPS
 #elif defined(__i386__)
 #define __suffix__ x86
+#define ELF_MACHINE EM_386
 #elif defined(__arm__)
 #define __suffix__ arm
+#define ELF_MACHINE EM_ARM
 #elif defined(__mips__)
 #define __suffix__ mips
+#define ELF_MACHINE EM_MIPS
 #else
 #error "unknown architecture"
 #endif
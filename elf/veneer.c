@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "veneer.h"
+#include "plt.h"
+#include "../debug.h"
+
+#define _make_stub ADD_SUFFIX(make_stub)
+
+/* some slack, for the arm pc bias */
+static inline bool
+in_range(addr_t P, addr_t range, addr_t addr) {
+    addr_t d = addr > P ? addr - P : P - addr;
+    return d < range - 16;
+}
+
+static inline size_t
+veneer_slot(Veneers * v, addr_t target) {
+    return (size_t)(((uint64_t)target * 11400714819323198485ull) >> 32)
+           & v->map_mask;
+}
+
+bool
+find_veneer(Veneers * v, addr_t P, addr_t range, addr_t target,
+            addr_t * addr) {
+    if(v->map == NULL)
+        return EXIT_FAILURE;
+    for(size_t i = veneer_slot(v, target); v->map[i].addr != 0x0;
+        i = (i + 1) & v->map_mask) {
+        if(v->map[i].target == target && in_range(P, range, v->map[i].addr)) {
+            *addr = v->map[i].addr;
+            v->shared++;
+            return EXIT_SUCCESS;
+        }
+    }
+    return EXIT_FAILURE;
+}
+
+static void
+insert(Stub * map, size_t mask, addr_t target, addr_t addr) {
+    size_t i = (size_t)(((uint64_t)target * 11400714819323198485ull) >> 32)
+               & mask;
+    while(map[i].addr != 0x0)
+        i = (i + 1) & mask;
+    map[i] = (Stub){ .addr = addr, .target = target };
+}
+
+void
+add_veneer(Veneers * v, addr_t target, addr_t addr) {
+    /* keep the map at most half full */
+    if(v->map == NULL || 2 * (v->count + 1) > v->map_mask + 1) {
+        size_t slots = v->map == NULL ? 256 : 2 * (v->map_mask + 1);
+        Stub * map = calloc(slots, sizeof(Stub));
+        assert(map != NULL);
+        for(size_t i = 0; v->map != NULL && i <= v->map_mask; i++)
+            if(v->map[i].addr != 0x0)
+                insert(map, slots - 1, v->map[i].target, v->map[i].addr);
+        free(v->map);
+        v->map = map;
+        v->map_mask = slots - 1;
+    }
+    insert(v->map, v->map_mask, target, addr);
+    v->count++;
+}
+
+/* map an island close to P, if the window has no room (in range) */
+static addr_t
+map_island_near(addr_t P, addr_t range) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    addr_t hint = (P & ~(addr_t)(page - 1)) > range / 2
+                  ? (P & ~(addr_t)(page - 1)) - range / 2 : 0x0;
+    void * mem = mmap((void*)hint, VENEER_ISLAND_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_ANON | MAP_PRIVATE, -1, 0);
+    if(mem == MAP_FAILED) {
+        link_log(LINK_LOG_WARN, LINK_LOG_STUB,
+                 "failed to mmap a veneer island. errno = %d\n", errno);
+        return 0x0;
+    }
+    if(!in_range(P, range, (addr_t)mem)
+       || !in_range(P, range, (addr_t)mem + VENEER_ISLAND_SIZE)) {
+        munmap(mem, VENEER_ISLAND_SIZE);
+        return 0x0;
+    }
+    return (addr_t)mem;
+}
+
+static VeneerIsland *
+island_for(Veneers * v, code_arena * arena, addr_t P, addr_t range) {
+    for(VeneerIsland * i = v->islands; i != NULL; i = i->next)
+        if(i->used + STUB_SIZE <= i->size
+           && in_range(P, range, i->start)
+           && in_range(P, range, i->start + i->size))
+            return i;
+
+    addr_t start = code_arena_map(arena, VENEER_ISLAND_SIZE);
+    if(start != 0x0
+       && !(in_range(P, range, start)
+            && in_range(P, range, start + VENEER_ISLAND_SIZE)))
+        start = 0x0; /* leave it; the window is taken up as it is */
+    bool mapped = false;
+    if(start == 0x0) {
+        start = map_island_near(P, range);
+        mapped = true;
+    }
+    if(start == 0x0)
+        return NULL;
+
+    VeneerIsland * i = calloc(1, sizeof(VeneerIsland));
+    assert(i != NULL);
+    i->start = start;
+    i->mapped = mapped;
+    i->size  = VENEER_ISLAND_SIZE;
+    i->next  = v->islands;
+    v->islands = i;
+    return i;
+}
+
+bool
+make_veneer(Veneers * v, code_arena * arena, addr_t P, addr_t range,
+            addr_t target, addr_t * addr) {
+    VeneerIsland * island = island_for(v, arena, P, range);
+    if(island == NULL) {
+        link_log(LINK_LOG_ERROR, LINK_LOG_STUB,
+                 "no veneer island in range of %p\n", (void*)P);
+        return EXIT_FAILURE;
+    }
+    Stub s = { .addr = island->start + island->used, .target = target };
+    if(_make_stub(&s))
+        return EXIT_FAILURE;
+    island->used += STUB_SIZE;
+    add_veneer(v, target, s.addr);
+    v->made++;
+    *addr = s.addr;
+    return EXIT_SUCCESS;
+}
+
+void
+seal_veneers(Veneers * v) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    for(VeneerIsland * i = v->islands; i != NULL; i = i->next) {
+        if(i->used == i->sealed)
+            continue;
+        /* the rest of the last page is given up */
+        size_t end = (i->used + page - 1) & ~(page - 1);
+        if(end > i->size) end = i->size;
+        if(0 != mprotect((void*)(i->start + i->sealed), end - i->sealed,
+                         PROT_READ | PROT_EXEC)) {
+            link_log(LINK_LOG_ERROR, LINK_LOG_MEMORY,
+                     "mprotect for veneer island %p failed! errno = %d\n",
+                     (void*)i->start, errno);
+            abort();
+        }
+        __builtin___clear_cache((char*)(i->start + i->sealed),
+                                (char*)(i->start + end));
+        i->sealed = i->used = end;
+    }
+}
+
+void
+free_veneers(Veneers * v) {
+    /* islands in the window are unmapped along with the window */
+    VeneerIsland * i = v->islands;
+    while(i != NULL) {
+        VeneerIsland * next = i->next;
+        if(i->mapped)
+            munmap((void*)i->start, i->size);
+        free(i);
+        i = next;
+    }
+    v->islands = NULL;
+    free(v->map);
+    v->map = NULL;
+    v->count = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef LINK_VENEER_H
+#define LINK_VENEER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../Types.h"
+#include "../CodeArena.h"
+
+/*
+ * Veneers for branches out of range, shared by all sections and objects of a
+ * session.
+ *
+ * Every veneer made (stubs in the stub space behind a text section included)
+ * is registered by its target.  A branch out of range first looks for a
+ * veneer to the same target in range of the branch; only if there is none, a
+ * new one is made: in the section's stub space if it has one, or else in a
+ * veneer island.  Islands are taken from the near code window (see
+ * CodeArena.h), where objects reserve no stub space at all, or otherwise are
+ * mapped close to the branch.
+ *
+ * Ranges are the branch's own (see reloc_range): a veneer, or an island, in
+ * range of one kind of branch at P need not be in range of another.
+ *
+ * Islands are writable while veneers are added, and sealed (made executable)
+ * by seal_veneers once the objects branching to them are resolved; nothing
+ * is added to a sealed page again.  All functions are writers, and are
+ * serialized by the linker lock.
+ */
+/* the range of the widest branch that may need a veneer: b/bl */
+#if defined(__aarch64__) || defined(__x86_64__)
+#define BRANCH_RANGE ((addr_t)128 << 20)
+#else
+#define BRANCH_RANGE ((addr_t)32 << 20)
+#endif
+
+#define VENEER_ISLAND_SIZE ((size_t)64 << 10)
+
+typedef struct _VeneerIsland {
+    addr_t start;
+    size_t size;
+    size_t used;
+    size_t sealed;   /* bytes at the start that are executable */
+    bool   mapped;   /* mapped on its own, not taken from the window */
+    struct _VeneerIsland * next;
+} VeneerIsland;
+
+typedef struct _Veneers {
+    /* all islands; the one veneers are added to first */
+    VeneerIsland * islands;
+
+    /* open addressing map over all veneers, by target; a target may have a
+     * veneer each in several places */
+    Stub  * map;
+    size_t  map_mask;
+    size_t  count;
+
+    unsigned long made;    /* in islands */
+    unsigned long shared;  /* branches sent through an existing veneer */
+} Veneers;
+
+/* The address of a veneer to target, within range of a branch at P. */
+bool
+find_veneer(Veneers * v, addr_t P, addr_t range, addr_t target,
+            addr_t * addr);
+
+/* Register a veneer at addr, branching to target. */
+void
+add_veneer(Veneers * v, addr_t target, addr_t addr);
+
+/* Make (and register) a veneer to target in an island within range of P. */
+bool
+make_veneer(Veneers * v, code_arena * arena, addr_t P, addr_t range,
+            addr_t target, addr_t * addr);
+
+/* Make the veneers added to islands since the last call executable. */
+void
+seal_veneers(Veneers * v);
+
+void
+free_veneers(Veneers * v);
+
+#endif //LINK_VENEER_H